@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationProfiler.h"
+
+//Replacement global allocation functions feeding the allocation profiler. Without
+//allocationProfilingEnabled they are plain malloc/free. Replacements can't be inline, so this
+//header must only be included from one translation unit (main.cpp)
+void* operator new(std::size_t size)
+{
+	alloc::detail::RecordAllocation(size);
+	if (auto p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	alloc::detail::RecordAllocation(size);
+	const auto align = size_t(alignment);
+#ifdef _MSC_VER
+	auto p = _aligned_malloc(size ? size : 1, align);
+#else
+	auto p = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align);
+#endif
+	if (p)
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return ::operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept
+{
+	if (p)
+	{
+		alloc::detail::RecordFree();
+		std::free(p);
+	}
+}
+
+void operator delete[](void* p) noexcept
+{
+	::operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	::operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	::operator delete(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	if (p)
+	{
+		alloc::detail::RecordFree();
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept
+{
+	::operator delete(p, alignment);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+	::operator delete(p, alignment);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+	::operator delete(p, alignment);
+}
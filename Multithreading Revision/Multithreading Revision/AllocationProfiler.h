@@ -0,0 +1,206 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <new>
+#include <ostream>
+
+#include "Constants.h"
+
+//Allocation accounting. Every allocation is charged to the calling thread and to the innermost
+//alloc::Scope tag active on that thread, so hot paths can be shown (and asserted) to be allocation-free.
+//Counting only happens with allocationProfilingEnabled, the new/delete hooks live in AllocationHooks.h.
+namespace alloc
+{
+	constexpr size_t MaxTags = 32;
+	constexpr size_t MaxThreads = 256;
+
+	struct Counts
+	{
+		uint64_t allocations = 0;
+		uint64_t frees = 0;
+		uint64_t bytes = 0;
+		Counts operator - (const Counts& rhs) const
+		{
+			return { allocations - rhs.allocations, frees - rhs.frees, bytes - rhs.bytes };
+		}
+	};
+
+	namespace detail
+	{
+		struct Counters
+		{
+			std::atomic<uint64_t> allocations;
+			std::atomic<uint64_t> frees;
+			std::atomic<uint64_t> bytes;
+		};
+
+		//One slot per thread keeps the counters uncontended, threads past MaxThreads share the last one
+		struct alignas(64) ThreadSlot
+		{
+			std::array<Counters, MaxTags> perTag;
+		};
+
+		//Static storage only: anything that allocated here would recurse into operator new
+		inline ThreadSlot slots[MaxThreads];
+		inline std::atomic<size_t> slotsUsed = 0;
+		inline std::array<std::atomic<const char*>, MaxTags> tagNames{};
+		inline std::array<std::atomic<uint64_t>, MaxTags> tagEntries{};
+		inline thread_local ThreadSlot* threadSlot = nullptr;
+		inline thread_local size_t currentTag = 0;
+
+		inline ThreadSlot& Slot()
+		{
+			if (!threadSlot)
+			{
+				threadSlot = &slots[std::min(slotsUsed.fetch_add(1, std::memory_order_relaxed), MaxThreads - 1)];
+			}
+			return *threadSlot;
+		}
+
+		inline void RecordAllocation(size_t bytes)
+		{
+			if constexpr (allocationProfilingEnabled)
+			{
+				auto& counters = Slot().perTag[currentTag];
+				counters.allocations.fetch_add(1, std::memory_order_relaxed);
+				counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+			}
+		}
+
+		inline void RecordFree()
+		{
+			if constexpr (allocationProfilingEnabled)
+			{
+				Slot().perTag[currentTag].frees.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		inline Counts Load(const Counters& counters)
+		{
+			return {
+				counters.allocations.load(std::memory_order_relaxed),
+				counters.frees.load(std::memory_order_relaxed),
+				counters.bytes.load(std::memory_order_relaxed)
+			};
+		}
+
+		//Tag 0 is "untagged", names are compared by content so every call site of a literal shares a tag
+		inline size_t RegisterTag(const char* name)
+		{
+			for (size_t i = 1; i < MaxTags; i++)
+			{
+				auto existing = tagNames[i].load(std::memory_order_acquire);
+				if (!existing && tagNames[i].compare_exchange_strong(existing, name, std::memory_order_acq_rel))
+				{
+					return i;
+				}
+				if (existing == name || std::strcmp(existing, name) == 0)
+				{
+					return i;
+				}
+			}
+			return 0;
+		}
+	}
+
+	//Charges allocations made on this thread to the named tag until it goes out of scope
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name)
+		{
+			if constexpr (allocationProfilingEnabled)
+			{
+				previous = detail::currentTag;
+				detail::currentTag = detail::RegisterTag(name);
+				detail::tagEntries[detail::currentTag].fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator = (const Scope&) = delete;
+		~Scope()
+		{
+			if constexpr (allocationProfilingEnabled)
+			{
+				detail::currentTag = previous;
+			}
+		}
+	private:
+		size_t previous = 0;
+	};
+
+	//Totals for the calling thread across all tags, diff two of these to measure a region
+	inline Counts ThisThread()
+	{
+		Counts total;
+		for (const auto& counters : detail::Slot().perTag)
+		{
+			const auto c = detail::Load(counters);
+			total.allocations += c.allocations;
+			total.frees += c.frees;
+			total.bytes += c.bytes;
+		}
+		return total;
+	}
+
+	//Asserts (debug builds) that the enclosed region makes no allocations on this thread
+	class NoAllocationScope
+	{
+	public:
+		explicit NoAllocationScope(const char* name) : scope{ name }
+		{
+			if constexpr (allocationProfilingEnabled)
+			{
+				before = ThisThread();
+			}
+		}
+		~NoAllocationScope()
+		{
+			if constexpr (allocationProfilingEnabled)
+			{
+				assert((ThisThread() - before).allocations == 0 && "allocation in allocation-free region");
+			}
+		}
+	private:
+		Scope scope;
+		Counts before;
+	};
+
+	//Per tag: allocations, bytes and how many of each per scope entry (i.e. per task / per chunk)
+	inline void Report(std::ostream& out)
+	{
+		if constexpr (!allocationProfilingEnabled)
+		{
+			out << "Allocation profiling disabled (allocationProfilingEnabled in Constants.h)\n";
+			return;
+		}
+		const auto threads = std::min(detail::slotsUsed.load(), MaxThreads);
+		out << "tag, entries, allocations, frees, bytes, allocations_per_entry, bytes_per_entry\n";
+		for (size_t tag = 0; tag < MaxTags; tag++)
+		{
+			const auto name = tag ? detail::tagNames[tag].load() : "untagged";
+			if (!name)
+			{
+				break;
+			}
+			Counts total;
+			for (size_t t = 0; t < threads; t++)
+			{
+				const auto c = detail::Load(detail::slots[t].perTag[tag]);
+				total.allocations += c.allocations;
+				total.frees += c.frees;
+				total.bytes += c.bytes;
+			}
+			const auto entries = detail::tagEntries[tag].load();
+			const auto perEntry = [entries](uint64_t v) {return entries ? double(v) / double(entries) : 0.; };
+			out << std::format("{}, {}, {}, {}, {}, {}, {}\n", name, entries, total.allocations, total.frees, total.bytes,
+				perEntry(total.allocations), perEntry(total.bytes));
+		}
+	}
+}
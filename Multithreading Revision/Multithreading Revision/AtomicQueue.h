@@ -1,233 +1,160 @@
 #pragma once
-#include <iostream>
-#include <thread>
-#include <mutex>
-#include <span>
 #include <format>
-#include <atomic>
+#include <optional>
+#include <ostream>
+#include <utility>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <string_view>
 
 #include "Constants.h"
 #include "Task.h"
-#include "Timing.h"
-#include "Timer.h"
+#include "ChunkView.h"
+#include "Runtime.h"
+#include "Workload.h"
+#include "ShardedRange.h"
+#include "Engine.h"
 
 namespace atq
 {
-	class WorkerControllerQueued
+	//How many tasks a worker claims at once, from the first unclaimed index start of total (workers sharing).
+	//Fixed-size policies claim with one fetch_add, the others size the claim from start in a CAS loop
+	namespace claim
 	{
-	public:
-		WorkerControllerQueued() : lk{ mtx } {}
-		void SignalDone()
+		template<typename P>
+		concept Policy = requires(size_t start, size_t total, size_t workers)
 		{
-			bool needsNotification = false;
-			{
-				std::lock_guard lk{ mtx };
-				++doneCount;
-				if (doneCount == WorkerCount)
-				{
-					needsNotification = true;
+			{ P::Size(start, total, workers) } -> std::convertible_to<size_t>;
+			{ P::fixed } -> std::convertible_to<bool>;
+			{ P::name } -> std::convertible_to<std::string_view>;
+		};
 
-				}
-			}
-
-			if (needsNotification)
-			{
-				cv.notify_one();
-			}
-		}
-
-		void WaitForAllDone()
-		{
-			cv.wait(lk, [this] {return doneCount == WorkerCount; });
-			doneCount = 0;
-		}
-
-		void SetChunk(std::span<const Task> chunk)
+		//One task per claim
+		struct Single
 		{
-			idx = 0;
-			currentChunk = chunk;
-		}
-
-		_declspec(noinline) const Task* GetTask()
-		{
-			//std::lock_guard lock{ mtx };
-			const auto i = idx.fetch_add(1, std::memory_order_relaxed);
-			if (i >= ChunkSize)
+			static constexpr bool fixed = true;
+			static constexpr std::string_view name = "single";
+			static size_t Size(size_t, size_t, size_t)
 			{
-				return nullptr;
+				return 1;
 			}
-			return &currentChunk[i];
-		}
+		};
 
-	private:
-		std::condition_variable cv;
-		std::mutex mtx; //Always Mutex with CV
-		std::unique_lock<std::mutex> lk;
-		std::span<const Task> currentChunk;
-		//Shared Memory
-		int doneCount = 0;
-		std::atomic<size_t> idx = 0;
-	};
-
-	class WorkerQueued
-	{
-	public:
-		WorkerQueued(WorkerControllerQueued* pWorkerController)
-			:
-			pController{ pWorkerController },
-			thread{ &WorkerQueued::Run_, this }
-		{}
-
-		void StartWork()
+		template<size_t K>
+		struct Fixed
 		{
+			static_assert(K >= 1);
+			static constexpr bool fixed = true;
+			static constexpr std::string_view name = "fixed";
+			static size_t Size(size_t, size_t, size_t)
 			{
-				std::lock_guard lk{ mtx };
-				working = true;
+				return K;
 			}
-			cv.notify_one();
-		}
+		};
 
-		void Kill()
+		//Guided self-scheduling: half of an even share of what is left
+		struct Guided
 		{
+			static constexpr bool fixed = false;
+			static constexpr std::string_view name = "guided";
+			static size_t Size(size_t start, size_t total, size_t workers)
 			{
-				std::lock_guard lk{ mtx };
-				terminate = true;
+				return std::max<size_t>((total - start) / (2 * workers), 1);
 			}
-			cv.notify_one();
-		}
-
-		unsigned int GetResult() const
-		{
-			return accululation;
-		}
-
-		float GetJobWorkTime() const
-		{
-			return workTime;
-		}
-
-		size_t GetNumHeavy() const
-		{
-			return numHeavyItems;
-		}
+		};
 
-		~WorkerQueued()
+		//Factoring: rounds of one claim per worker, each round hands out half of what is left.
+		//Round j starts at total * (1 - 2^-j), so the round follows from start
+		struct Factoring
 		{
-			Kill();
-		}
-
-	private:
-		void ProcessData_()
-		{
-			numHeavyItems = 0;
-			while (auto pTask = pController->GetTask())
+			static constexpr bool fixed = false;
+			static constexpr std::string_view name = "factoring";
+			static size_t Size(size_t start, size_t total, size_t workers)
 			{
-				accululation += pTask->Process();
-
-				if constexpr (timingMeasurementEnabled)
-				{
-					numHeavyItems += pTask->heavy;
-				}
+				const auto round = std::bit_width(total / std::max<size_t>(total - start, 1)) - 1;
+				const auto share = (total >> round) / (2 * workers);
+				return std::max<size_t>(share, 1);
 			}
-		}
+		};
 
-		void Run_()
+		//Trapezoid self-scheduling: claim sizes fall linearly from total / (2 * workers) to 1 over the chunk.
+		//Claim i starts at i * first - step * i * (i - 1) / 2, solved for i to find the claim number at start
+		struct Trapezoid
 		{
-			std::unique_lock lk{ mtx };
-			while (true)
+			static constexpr bool fixed = false;
+			static constexpr std::string_view name = "trapezoid";
+			static size_t Size(size_t start, size_t total, size_t workers)
 			{
-				Timer timer;
-				cv.wait(lk, [this] {return working || terminate; });
-				if (terminate)
-				{
-					break;
-				}
-
-				if constexpr (timingMeasurementEnabled)
-				{
-					timer.Mark();
-				}
-				ProcessData_();
-				if constexpr (timingMeasurementEnabled)
+				const auto first = std::max(double(total) / double(2 * workers), 1.);
+				const auto claims = std::ceil(2. * double(total) / (first + 1.));
+				const auto step = claims > 1. ? (first - 1.) / (claims - 1.) : 0.;
+				if (step == 0.)
 				{
-					workTime = timer.Peek();
+					return size_t(std::ceil(first));
 				}
-
-				working = false;
-				pController->SignalDone();
+				const auto b = first + step / 2.;
+				const auto i = std::floor((b - std::sqrt(std::max(b * b - 2. * step * double(start), 0.))) / step);
+				return size_t(std::max(std::ceil(first - i * step), 1.));
 			}
-		}
-		WorkerControllerQueued* pController;
-		std::jthread thread;
-		std::condition_variable cv;
-		std::mutex mtx;
-
-		//Shared Memory
-		unsigned int accululation = 0;
-		bool terminate = false;
-		bool working = false;
-		float workTime = -1.f;
-		size_t numHeavyItems;
-	};
+		};
+	}
 
-	int Experiment(Dataset chunks)
+	//Ranges sized by Claim, out of the worker's claim group first (sized for the workers sharing it), then out
+	//of the other groups
+	template<claim::Policy Claim>
+	struct Distribution
 	{
-		Timer totalTime;
-		totalTime.Mark();
-
-		//Create Worker Threads
-		WorkerControllerQueued workerController; //Initialise Controller
-		std::vector<std::unique_ptr<WorkerQueued>> workerPtrs(WorkerCount);
-		std::ranges::generate(workerPtrs, [&workerController] {return std::make_unique<WorkerQueued>(&workerController); });
-
-		std::vector<ChunkTimeInfo> timings;
-		timings.reserve(ChunkCount);
-
-		Timer chunkTimer;
-		for (const auto& chunk : chunks)
+		template<typename View, Workload W>
+		class For
 		{
-			if constexpr (timingMeasurementEnabled)
+		public:
+			explicit For(size_t workerCount) : ranges{ workerCount } {}
+
+			void SetChunk(View chunk)
 			{
-				chunkTimer.Mark();
+				ranges.Reset(chunk.size());
+				currentChunk = chunk;
 			}
 
-			workerController.SetChunk(chunk);
-			for (const auto& w : workerPtrs)
+			template<typename Sink>
+			void Process(size_t worker, Sink& sink)
 			{
-				w->StartWork();
-				//workerPtrs[iSubset]->SetJob(std::span{ &chunk[iSubset * SubsetSize], SubsetSize });
-				//workerThreads.push_back(std::jthread{ ProcessData, std::span{&datasets[j][i], subsetSize}, std::ref(sum[j].i)});
+				size_t group = ranges.HomeGroup(worker);
+				while (const auto range = ClaimRange(group))
+				{
+					sink.Range(*range);
+				}
 			}
-			workerController.WaitForAllDone();
 
-			const auto chunkTime = chunkTimer.Peek();
+			void Report(std::ostream& out, size_t chunkCount, size_t claims) const
+			{
+				out << std::format("{:.1f} claims per chunk ({})\n", chunkCount ? double(claims) / double(chunkCount) : 0., Claim::name);
+			}
 
-			if constexpr (timingMeasurementEnabled)
+		private:
+			//Next range of tasks, empty once the chunk is used up
+			_declspec(noinline) std::optional<View> ClaimRange(size_t& group)
 			{
-				timings.push_back({});
-				for (size_t i = 0; i < WorkerCount; i++)
+				const auto range = ranges.template Claim<Claim::fixed>(group, [this](size_t start, size_t total) {return Claim::Size(start, total, ranges.GroupWorkers()); });
+				if (!range)
 				{
-					timings.back().numberOfHeavyPerThread[i] = workerPtrs[i]->GetNumHeavy();
-					timings.back().timeSpentWorkingPerThread[i] = workerPtrs[i]->GetJobWorkTime();
+					return {};
 				}
-				timings.back().totalChunkTime = chunkTime;
+				return currentChunk.Subview(range->first, range->second);
 			}
-		}
-
-		auto t = totalTime.Peek();
-		std::cout << "Processing took " << t << " seconds\n";
 
-		unsigned int result = 0;
-		for (const auto& w : workerPtrs)
-		{
-			result += w->GetResult();
-		}
-		std::cout << "Result is " << result << std::endl;
+			//Read by every claim, written only between chunks. The claim counters live in ranges' own cache lines
+			View currentChunk;
+			tk::ShardedRange<> ranges;
+		};
+	};
 
-		if constexpr (timingMeasurementEnabled)
-		{
-			WriteCSV(timings);
-		}
-		return 0;
+	//Runs any Workload, Task data as a Dataset or an SoaDataset
+	template<Workload W = TaskWorkload<>, claim::Policy Claim = claim::Guided, typename Data>
+	int Experiment(Data chunks, size_t workerCount = tk::DefaultWorkerCount(), W workload = W{})
+	{
+		return eng::Engine<Distribution<Claim>>::Experiment(std::move(chunks), workerCount, std::move(workload));
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+
+namespace tk
+{
+	//Bounded lock-free ring (Vyukov sequence cells). Safe for any mix of producers/consumers,
+	//with a single producer and single consumer each side's CAS is uncontended.
+	//Push blocks while full (backpressure), Pop blocks while empty, Close wakes everyone.
+	template<typename T>
+	class Channel
+	{
+		static_assert(std::is_default_constructible_v<T> && std::is_move_assignable_v<T>);
+	public:
+		Channel(size_t capacity)
+			:
+			mask{ std::bit_ceil(std::max<size_t>(capacity, 2)) - 1 },
+			cells{ std::make_unique<Cell[]>(mask + 1) }
+		{
+			for (size_t i = 0; i <= mask; i++)
+			{
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+		Channel(const Channel&) = delete;
+		Channel& operator = (const Channel&) = delete;
+
+		//Returns false if the channel was closed before the value could be queued
+		bool Push(T value)
+		{
+			while (true)
+			{
+				const auto seen = popped.load(std::memory_order_acquire);
+				if (closed.load(std::memory_order_acquire))
+				{
+					return false;
+				}
+				if (TryPush_(value))
+				{
+					pushed.fetch_add(1, std::memory_order_release);
+					pushed.notify_one();
+					return true;
+				}
+				popped.wait(seen, std::memory_order_acquire);
+			}
+		}
+
+		//Returns empty once the channel is closed and drained
+		std::optional<T> Pop()
+		{
+			T value;
+			while (true)
+			{
+				const auto seen = pushed.load(std::memory_order_acquire);
+				if (TryPop_(value))
+				{
+					popped.fetch_add(1, std::memory_order_release);
+					popped.notify_one();
+					return value;
+				}
+				if (closed.load(std::memory_order_acquire))
+				{
+					//Drain anything queued before the close was observed
+					if (TryPop_(value))
+					{
+						return value;
+					}
+					return {};
+				}
+				pushed.wait(seen, std::memory_order_acquire);
+			}
+		}
+
+		void Close()
+		{
+			closed.store(true, std::memory_order_release);
+			pushed.fetch_add(1, std::memory_order_release);
+			pushed.notify_all();
+			popped.fetch_add(1, std::memory_order_release);
+			popped.notify_all();
+		}
+
+		size_t GetCapacity() const
+		{
+			return mask + 1;
+		}
+
+	private:
+		bool TryPush_(T& value)
+		{
+			auto pos = enqueuePos.load(std::memory_order_relaxed);
+			while (true)
+			{
+				auto& cell = cells[pos & mask];
+				const auto seq = cell.sequence.load(std::memory_order_acquire);
+				const auto diff = intptr_t(seq) - intptr_t(pos);
+				if (diff == 0)
+				{
+					if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						cell.value = std::move(value);
+						cell.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0)
+				{
+					return false; //Full
+				}
+				else
+				{
+					pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool TryPop_(T& value)
+		{
+			auto pos = dequeuePos.load(std::memory_order_relaxed);
+			while (true)
+			{
+				auto& cell = cells[pos & mask];
+				const auto seq = cell.sequence.load(std::memory_order_acquire);
+				const auto diff = intptr_t(seq) - intptr_t(pos + 1);
+				if (diff == 0)
+				{
+					if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						value = std::move(cell.value);
+						cell.sequence.store(pos + mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0)
+				{
+					return false; //Empty
+				}
+				else
+				{
+					pos = dequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		const size_t mask;
+		std::unique_ptr<Cell[]> cells;
+
+		//Producers and consumers each get their own line
+		alignas(std::hardware_destructive_interference_size) std::atomic<size_t> enqueuePos = 0;
+		alignas(std::hardware_destructive_interference_size) std::atomic<size_t> dequeuePos = 0;
+		//Wake counters, bumped after a cell is published so a waiter can never miss a transition
+		alignas(std::hardware_destructive_interference_size) std::atomic<uint32_t> pushed = 0;
+		alignas(std::hardware_destructive_interference_size) std::atomic<uint32_t> popped = 0;
+		std::atomic<bool> closed = false;
+	};
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "CounterRng.h"
+#include "DatasetFile.h"
+#include "HugePages.h"
+
+//Chunks produced while the previous ones are being processed. A producer thread fills a ring of depth
+//chunk buffers ahead of the consumer, a buffer is recycled once the consumer moves past its chunk,
+//so only depth chunks are ever resident and producing overlaps processing.
+namespace buf
+{
+	template<typename C>
+	using FillFunction = std::function<void(C& chunk, size_t chunkIndex)>;
+
+	//Usable wherever a Dataset / SoaDataset is (C says which), copies share the ring. Iterating starts a
+	//pass that produces every chunk in order, one pass at a time: a new begin() restarts production.
+	//A chunk stays valid until the iterator is incremented past it.
+	template<typename C>
+	class Source
+	{
+		class State
+		{
+		public:
+			State(size_t count, FillFunction<C> fill, size_t depth)
+				:
+				fill{ std::move(fill) },
+				count{ count },
+				ring(std::max<size_t>(depth, 1))
+			{}
+			State(const State&) = delete;
+			State& operator = (const State&) = delete;
+
+			void Restart()
+			{
+				producer = {};
+				produced = 0;
+				consumed = 0;
+				error = nullptr;
+				producer = std::jthread{ [this](std::stop_token st) {Produce_(st); } };
+			}
+
+			const C& Acquire(size_t k)
+			{
+				std::unique_lock lk{ mtx };
+				cv.wait(lk, [&] {return produced > k || error; });
+				if (error)
+				{
+					std::rethrow_exception(error);
+				}
+				return ring[k % ring.size()];
+			}
+
+			void Release(size_t k)
+			{
+				{
+					std::lock_guard lk{ mtx };
+					consumed = k + 1;
+				}
+				cv.notify_all();
+			}
+
+		private:
+			void Produce_(std::stop_token st)
+			{
+				for (size_t k = 0; k < count; k++)
+				{
+					{
+						std::unique_lock lk{ mtx };
+						//Slot k % depth is free once chunk k - depth has been consumed
+						if (!cv.wait(lk, st, [&] {return k - consumed < ring.size(); }))
+						{
+							return;
+						}
+					}
+					try {
+						fill(ring[k % ring.size()], k);
+					}
+					catch (...)
+					{
+						std::lock_guard lk{ mtx };
+						error = std::current_exception();
+						cv.notify_all();
+						return;
+					}
+					{
+						std::lock_guard lk{ mtx };
+						produced = k + 1;
+					}
+					cv.notify_all();
+				}
+			}
+
+			FillFunction<C> fill;
+			size_t count;
+			mem::Vector<C> ring;
+			std::mutex mtx;
+			std::condition_variable_any cv;
+			size_t produced = 0; //Chunks [0, produced) are in the ring
+			size_t consumed = 0; //Chunks [0, consumed) are done with
+			std::exception_ptr error;
+			std::jthread producer;
+		};
+
+	public:
+		using value_type = C;
+
+		//The producer is a thread of its own, outside the runtime: experiments on a Source run this many
+		//workers fewer, so producing and processing together stay within the CPU budget
+		static constexpr size_t ProducerThreads = 1;
+
+		class Iterator
+		{
+		public:
+			using value_type = C;
+			using difference_type = std::ptrdiff_t;
+
+			Iterator() = default;
+			Iterator(State* pState, size_t k) : pState{ pState }, k{ k } {}
+			const C& operator * () const
+			{
+				return pState->Acquire(k);
+			}
+			Iterator& operator ++ ()
+			{
+				pState->Release(k++);
+				return *this;
+			}
+			//The old iterator's chunk is released, it can be compared but no longer dereferenced
+			Iterator operator ++ (int)
+			{
+				auto old = *this;
+				++*this;
+				return old;
+			}
+			bool operator == (const Iterator& rhs) const
+			{
+				return k == rhs.k;
+			}
+
+		private:
+			State* pState = nullptr;
+			size_t k = 0;
+		};
+
+		//depth 2 is double buffering: one chunk being processed, the next one being produced
+		Source(size_t count, FillFunction<C> fill, size_t depth = 2)
+			:
+			count{ count },
+			state{ std::make_shared<State>(count, std::move(fill), depth) }
+		{}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		Iterator begin() const
+		{
+			state->Restart();
+			return { state.get(), 0 };
+		}
+
+		Iterator end() const
+		{
+			return { state.get(), count };
+		}
+
+	private:
+		size_t count;
+		std::shared_ptr<State> state;
+	};
+
+	static_assert(std::input_iterator<Source<Chunk>::Iterator>);
+
+	//Counter-based generation (see CounterRng.h), the same chunks rng::Generate makes
+	template<typename C = Chunk, rng::TaskFunction Make = rng::RandomTask>
+	Source<C> Generate(uint64_t seed = rng::DefaultSeed, size_t chunkCount = ChunkCount, double probabilityHeavy = ProbabilityHeavy, size_t depth = 2)
+	{
+		return { chunkCount, [seed, probabilityHeavy](C& chunk, size_t k) {rng::FillChunk<Make>(chunk, k, seed, probabilityHeavy); }, depth };
+	}
+
+	//Copies chunks out of a dataset file, the page faults are taken on the producer thread
+	//and each chunk's pages are dropped from the mapping once copied
+	template<typename C>
+	Source<C> Load(dsf::MappedDataset<C> file, size_t depth = 2)
+	{
+		const auto count = file.size();
+		return { count, [file](C& chunk, size_t k) {chunk = file[k]; file.Release(k); }, depth };
+	}
+}
@@ -0,0 +1,294 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+#include "HugePages.h"
+
+//Structure-of-arrays chunk: values back to back for vector loads, heavy flags packed one bit per task.
+//8 bytes per task instead of the 16 a padded Task takes.
+struct SoaChunk
+{
+	static constexpr size_t Words = (ChunkSize + 63) / 64;
+
+	alignas(64) std::array<double, ChunkSize> val;
+	alignas(64) std::array<uint64_t, Words> heavy{};
+
+	bool IsHeavy(size_t i) const
+	{
+		return (heavy[i / 64] >> (i % 64)) & 1;
+	}
+
+	void SetHeavy(size_t i, bool isHeavy)
+	{
+		const auto bit = uint64_t(1) << (i % 64);
+		heavy[i / 64] = isHeavy ? heavy[i / 64] | bit : heavy[i / 64] & ~bit;
+	}
+
+	//Heavy flags of tasks [i, i + n) as the low n bits, n <= 64
+	uint64_t HeavyBits(size_t i, size_t n) const
+	{
+		const auto word = i / 64, shift = i % 64;
+		auto bits = heavy[word] >> shift;
+		if (shift && shift + n > 64 && word + 1 < Words)
+		{
+			bits |= heavy[word + 1] << (64 - shift);
+		}
+		return n < 64 ? bits & ((uint64_t(1) << n) - 1) : bits;
+	}
+
+	//Heavy tasks in [begin, end), a popcount per word
+	size_t HeavyCount(size_t begin = 0, size_t end = ChunkSize) const
+	{
+		size_t count = 0;
+		for (auto i = begin; i < end; )
+		{
+			const auto n = std::min<size_t>(64 - i % 64, end - i);
+			count += std::popcount(HeavyBits(i, n));
+			i += n;
+		}
+		return count;
+	}
+
+	//Calls f(index) for every heavy task in [begin, end), skipping light tasks a word at a time
+	template<typename F>
+	void ForEachHeavy(size_t begin, size_t end, F&& f) const
+	{
+		for (auto i = begin; i < end; )
+		{
+			const auto n = std::min<size_t>(64 - i % 64, end - i);
+			for (auto bits = HeavyBits(i, n); bits; bits &= bits - 1)
+			{
+				f(i + std::countr_zero(bits));
+			}
+			i += n;
+		}
+	}
+
+	Task operator[](size_t i) const
+	{
+		return Task{ .val = val[i], .heavy = IsHeavy(i) };
+	}
+};
+
+using SoaDataset = mem::Vector<SoaChunk>;
+
+inline SoaDataset ToSoa(const Dataset& data)
+{
+	SoaDataset chunks(data.size());
+	for (size_t c = 0; c < data.size(); c++)
+	{
+		for (size_t i = 0; i < ChunkSize; i++)
+		{
+			chunks[c].val[i] = data[c][i].val;
+			chunks[c].SetHeavy(i, data[c][i].heavy);
+		}
+	}
+	return chunks;
+}
+
+//What the strategies see of a chunk (or a slice of one), whatever its layout.
+//Views are cheap to copy and default-construct to empty.
+template<typename V>
+concept ChunkViewType = std::copyable<V> && requires(const V v, size_t i)
+{
+	{ v.size() } -> std::convertible_to<size_t>;
+	{ v[i] } -> std::convertible_to<Task>;
+	{ v.Subview(i, i) } -> std::same_as<V>;
+	{ v.HeavyCount() } -> std::convertible_to<size_t>;
+	{ V::contiguousValues } -> std::convertible_to<bool>;
+	v.ForEachRun([](size_t, size_t, bool) {});
+};
+
+class AosChunkView
+{
+public:
+	static constexpr bool contiguousValues = false;
+
+	AosChunkView() = default;
+	AosChunkView(std::span<const Task> tasks) : tasks{ tasks } {}
+
+	size_t size() const
+	{
+		return tasks.size();
+	}
+
+	bool empty() const
+	{
+		return tasks.empty();
+	}
+
+	Task operator[](size_t i) const
+	{
+		return tasks[i];
+	}
+
+	AosChunkView Subview(size_t begin, size_t end) const
+	{
+		return tasks.subspan(begin, end - begin);
+	}
+
+	size_t HeavyCount() const
+	{
+		return std::ranges::count(tasks, true, &Task::heavy);
+	}
+
+	//Calls f(begin, end, heavy) for every maximal run of tasks with the same weight
+	template<typename F>
+	void ForEachRun(F&& f) const
+	{
+		for (size_t begin = 0, end; begin < tasks.size(); begin = end)
+		{
+			const auto heavy = tasks[begin].heavy;
+			for (end = begin + 1; end < tasks.size() && tasks[end].heavy == heavy; end++);
+			f(begin, end, heavy);
+		}
+	}
+
+private:
+	std::span<const Task> tasks;
+};
+
+class SoaChunkView
+{
+public:
+	static constexpr bool contiguousValues = true;
+
+	SoaChunkView() = default;
+	SoaChunkView(const SoaChunk& chunk, size_t begin = 0, size_t end = ChunkSize) : chunk{ &chunk }, begin{ begin }, end{ end } {}
+
+	size_t size() const
+	{
+		return end - begin;
+	}
+
+	bool empty() const
+	{
+		return begin == end;
+	}
+
+	Task operator[](size_t i) const
+	{
+		return (*chunk)[begin + i];
+	}
+
+	SoaChunkView Subview(size_t first, size_t last) const
+	{
+		return { *chunk, begin + first, begin + last };
+	}
+
+	size_t HeavyCount() const
+	{
+		return empty() ? 0 : chunk->HeavyCount(begin, end);
+	}
+
+	const double* Values() const
+	{
+		return chunk->val.data() + begin;
+	}
+
+	uint64_t HeavyBits(size_t i, size_t n) const
+	{
+		return chunk->HeavyBits(begin + i, n);
+	}
+
+	//Same as AosChunkView::ForEachRun, run lengths come from counting zeros/ones a word at a time
+	template<typename F>
+	void ForEachRun(F&& f) const
+	{
+		for (size_t runBegin = 0, i = 0; i < size(); )
+		{
+			const auto heavy = chunk->IsHeavy(begin + runBegin);
+			const auto n = std::min<size_t>(64, size() - i);
+			const auto bits = HeavyBits(i, n);
+			const auto same = size_t(std::countr_zero(heavy ? ~bits : bits));
+			if (same < n)
+			{
+				i += same;
+				f(runBegin, i, heavy);
+				runBegin = i;
+			}
+			else
+			{
+				i += n;
+				if (i == size())
+				{
+					f(runBegin, i, heavy);
+				}
+			}
+		}
+	}
+
+	template<typename F>
+	void ForEachHeavy(F&& f) const
+	{
+		if (!empty())
+		{
+			chunk->ForEachHeavy(begin, end, [&](size_t i) {f(i - begin); });
+		}
+	}
+
+private:
+	const SoaChunk* chunk = nullptr;
+	size_t begin = 0;
+	size_t end = 0;
+};
+
+//Chunks of any other item type (see Workload.h) are looked at through a plain span
+template<typename Item>
+class SpanView
+{
+public:
+	SpanView() = default;
+	SpanView(std::span<const Item> items) : items{ items } {}
+
+	size_t size() const
+	{
+		return items.size();
+	}
+
+	bool empty() const
+	{
+		return items.empty();
+	}
+
+	const Item& operator[](size_t i) const
+	{
+		return items[i];
+	}
+
+	SpanView Subview(size_t begin, size_t end) const
+	{
+		return items.subspan(begin, end - begin);
+	}
+
+private:
+	std::span<const Item> items;
+};
+
+template<std::ranges::contiguous_range C>
+SpanView<std::ranges::range_value_t<C>> MakeView(const C& chunk)
+{
+	return std::span{ std::ranges::data(chunk), std::ranges::size(chunk) };
+}
+
+inline AosChunkView MakeView(const Chunk& chunk)
+{
+	return std::span<const Task>{ chunk };
+}
+
+inline SoaChunkView MakeView(const SoaChunk& chunk)
+{
+	return { chunk };
+}
+
+//View type the strategies use for a Dataset, an SoaDataset or a vector of chunks of any workload
+template<typename Data>
+using ViewOf = decltype(MakeView(std::declval<const typename Data::value_type&>()));
@@ -0,0 +1,742 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+#include "Timer.h"
+#include "Workload.h"
+#include "Preassigned.h"
+#include "Queued.h"
+#include "AtomicQueue.h"
+#include "Continuous.h"
+#include "Stealing.h"
+#include "Hybrid.h"
+#include "Pipelined.h"
+#include "CpuBudget.h"
+#include "HugePages.h"
+#include "Generators.h"
+#include "CounterRng.h"
+#include "DatasetFile.h"
+#include "ChunkSource.h"
+#include "ShardedRange.h"
+#include "FalseSharing.h"
+#include "Epoch.h"
+#include "popl.h"
+
+//Experiment parameters chosen on the command line. The values in Constants.h are the defaults and the
+//configuration the kernels are compiled for: when chunk size and trip counts match, the experiment runs on
+//std::array chunks (SoaChunks with --layout soa) and the tuned kernels, otherwise on chunks and trip counts
+//sized at runtime.
+namespace cfg
+{
+	enum class Strategy
+	{
+		Preassigned,
+		Queued,
+		AtomicQueued,
+		Continuous,
+		Stealing,
+		Hybrid,
+		Pipelined, //Generates its own chunks as it goes, random / even / stacked only
+	};
+
+	//Claim policy of the atomic-queued, continuous and hybrid strategies (see atq::claim)
+	enum class Claim
+	{
+		Single,
+		Fixed,
+		Guided,
+		Factoring,
+		Trapezoid,
+	};
+
+	constexpr size_t FixedClaimSize = 64;
+
+	constexpr std::array<std::pair<std::string_view, Claim>, 5> Claims{ {
+		{ "single", Claim::Single },
+		{ "fixed", Claim::Fixed },
+		{ "guided", Claim::Guided },
+		{ "factoring", Claim::Factoring },
+		{ "trapezoid", Claim::Trapezoid },
+	} };
+
+	//Math policy of the heavy / light task kernels (see math::Policy)
+	enum class Math
+	{
+		Libm,
+		FastPoly,
+		Float,
+	};
+
+	constexpr std::array<std::pair<std::string_view, Math>, 3> Maths{ {
+		{ "libm", Math::Libm },
+		{ "fastpoly", Math::FastPoly },
+		{ "float", Math::Float },
+	} };
+
+	constexpr Math DefaultMath = std::is_same_v<math::Default, math::FastPoly> ? Math::FastPoly : Math::Libm;
+
+	enum class Distribution
+	{
+		Random,
+		Even,
+		Stacked,
+		Bursty,
+		Drifting,
+		Clustered,
+		AdversarialPreassigned,
+		AdversarialTail,
+		Zipf, //Continuous costs, run as gen::CostedWorkload
+		LogNormal, //Continuous costs, run as gen::CostedWorkload
+	};
+
+	constexpr std::array<std::pair<std::string_view, Distribution>, 10> Shapes{ {
+		{ "random", Distribution::Random },
+		{ "even", Distribution::Even },
+		{ "stacked", Distribution::Stacked },
+		{ "bursty", Distribution::Bursty },
+		{ "drifting", Distribution::Drifting },
+		{ "clustered", Distribution::Clustered },
+		{ "adversarial-pre", Distribution::AdversarialPreassigned },
+		{ "adversarial-tail", Distribution::AdversarialTail },
+		{ "zipf", Distribution::Zipf },
+		{ "lognormal", Distribution::LogNormal },
+	} };
+
+	//What --stress sweeps, pipelined is left out as it can't run most shapes
+	constexpr std::array<std::pair<std::string_view, Strategy>, 6> Strategies{ {
+		{ "preassigned", Strategy::Preassigned },
+		{ "queued", Strategy::Queued },
+		{ "atomic-queued", Strategy::AtomicQueued },
+		{ "continuous", Strategy::Continuous },
+		{ "stealing", Strategy::Stealing },
+		{ "hybrid", Strategy::Hybrid },
+	} };
+
+	constexpr bool Costed(Distribution distribution)
+	{
+		return distribution == Distribution::Zipf || distribution == Distribution::LogNormal;
+	}
+
+	//Shapes every chunk of which can be generated on its own (see CounterRng.h)
+	constexpr bool CounterBased(Distribution distribution)
+	{
+		return distribution == Distribution::Random || distribution == Distribution::Even || distribution == Distribution::Stacked;
+	}
+
+	struct Params
+	{
+		Strategy strategy = Strategy::Preassigned;
+		Distribution distribution = Distribution::Random;
+		Claim claim = Claim::Guided;
+		std::optional<double> staticFraction; //Hybrid, empty adapts it per chunk
+		size_t workers = 0; //0 follows the CPU budget
+		size_t chunkSize = ChunkSize;
+		size_t chunkCount = ChunkCount;
+		double probabilityHeavy = ProbabilityHeavy;
+		uint64_t seed = rng::DefaultSeed;
+		size_t lightIterations = LightIterations;
+		size_t heavyIterations = HeavyIterations;
+		dsf::Layout layout = dsf::Layout::Aos; //Chunks of the compiled size as Chunk or SoaChunk, in memory and in files
+		Math math = DefaultMath; //Runtime-sized and costed runs are libm whatever this says
+		double errorBound = MathErrorBound; //Relative error on the result allowed for fastpoly and float
+		mem::HugePages hugePages = mem::HugePages::Transparent;
+		bool stress = false; //Every shape on every strategy
+		std::optional<std::filesystem::path> writeDataset; //Generate into this file instead of running
+		std::optional<std::filesystem::path> dataset; //Run on this file instead of generating
+		bool verifyDataset = false; //Checksum the whole file before running on it
+		bool streamed = false; //Chunks produced on a background thread, a few ahead of the workers
+		bool claimBench = false; //Shared against sharded claim counters instead of an experiment
+		bool sharingBench = false; //Packed against padded per-worker state instead of an experiment
+		bool dispatchBench = false; //Handshake against epoch dispatch round trips instead of an experiment
+		bool demos = false; //Thread pool demos and kernel validations instead of an experiment
+		bool help = false;
+
+		//Everything the Chunk type and the tuned kernels are compiled for matches
+		bool Specialized() const
+		{
+			return chunkSize == ChunkSize && lightIterations == LightIterations && heavyIterations == HeavyIterations;
+		}
+	};
+
+	using RuntimeChunk = mem::Vector<Task>;
+	using RuntimeDataset = mem::Vector<RuntimeChunk>;
+
+	class Options
+	{
+	public:
+		Options()
+			:
+			parser{ "Options" }
+		{
+			help = parser.add<popl::Switch>("h", "help", "Show this help");
+			queued = parser.add<popl::Switch>("", "queued", "Workers take tasks from a locked queue");
+			atomicQueued = parser.add<popl::Switch>("", "atomic-queued", "Workers take tasks through an atomic index");
+			continuous = parser.add<popl::Switch>("", "continuous", "Atomic-queued with no barrier between chunks");
+			stealing = parser.add<popl::Switch>("", "stealing", "Preassigned subsets, idle workers steal half of the largest one left");
+			hybrid = parser.add<popl::Switch>("", "hybrid", "Preassigned head of each chunk, atomic-queued tail");
+			pipelined = parser.add<popl::Switch>("", "pipelined", "Generate, process and reduce stages streamed through the pool (random, even or stacked)");
+			staticFraction = parser.add<popl::Value<std::string>>("", "static-fraction", "Hybrid share of each chunk preassigned, within [0, 1], or auto to adapt it", "auto");
+			even = parser.add<popl::Switch>("", "even", "Heavy tasks evenly spaced");
+			stacked = parser.add<popl::Switch>("", "stacked", "Heavy tasks at the front of each chunk");
+			shape = parser.add<popl::Value<std::string>>("", "shape", "Load shape: random, even, stacked, bursty, drifting, clustered, adversarial-pre, adversarial-tail, zipf or lognormal", "random");
+			stress = parser.add<popl::Switch>("", "stress", "Run every shape on every strategy");
+			writeDataset = parser.add<popl::Value<std::string>>("", "write-dataset", "Write the generated dataset to this file instead of running an experiment");
+			dataset = parser.add<popl::Value<std::string>>("", "dataset", "Run the experiment on a dataset file written with --write-dataset, mapped rather than loaded");
+			verifyDataset = parser.add<popl::Switch>("", "verify-dataset", "Check the --dataset file against its checksum before running on it, a full read of the file");
+			streamed = parser.add<popl::Switch>("", "streamed", "Produce chunks (generated, or copied out of --dataset) on a background thread, which takes one of the workers, while the previous ones are processed");
+			claimBench = parser.add<popl::Switch>("", "claim-bench", "Time shared against sharded claim counters for 4 to 128 workers");
+			sharingBench = parser.add<popl::Switch>("", "sharing-bench", "Time and count cache misses of packed against padded per-worker state");
+			dispatchBench = parser.add<popl::Switch>("", "dispatch-bench", "Time starting and collecting workers, per-worker handshakes against epoch dispatch");
+			demos = parser.add<popl::Switch>("", "demos", "Run the thread pool demos (exceptions, polling, fair sharing) and the enabled kernel validations");
+			claim = parser.add<popl::Value<std::string>>("", "claim", "Atomic-queued / continuous / hybrid claim policy: single, fixed (64 tasks), guided, factoring or trapezoid", "guided");
+			workers = parser.add<popl::Value<size_t>>("w", "workers", "Worker count, 0 follows the CPU budget", 0);
+			chunkSize = parser.add<popl::Value<size_t>>("", "chunk-size", "Tasks per chunk", ChunkSize);
+			chunkCount = parser.add<popl::Value<size_t>>("", "chunk-count", "Chunks in the dataset", ChunkCount);
+			probabilityHeavy = parser.add<popl::Value<double>>("", "heavy-probability", "Fraction of heavy tasks", ProbabilityHeavy);
+			seed = parser.add<popl::Value<uint64_t>>("", "seed", "Seed of the generated dataset", rng::DefaultSeed);
+			lightIterations = parser.add<popl::Value<size_t>>("", "light-iterations", "Iterations of a light task", LightIterations);
+			heavyIterations = parser.add<popl::Value<size_t>>("", "heavy-iterations", "Iterations of a heavy task", HeavyIterations);
+			layout = parser.add<popl::Value<std::string>>("", "layout", "Chunk layout: aos (Task array) or soa (values and packed heavy bits), soa needs the compiled chunk size", "aos");
+			math = parser.add<popl::Value<std::string>>("", "math", "Task math: libm, fastpoly (polynomial sin / cos) or float, on heavy / light chunks of the compiled size and trip counts",
+				std::string{ std::ranges::find(Maths, DefaultMath, &std::pair<std::string_view, Math>::second)->first });
+			errorBound = parser.add<popl::Value<double>>("", "error-bound", "Relative error on the result allowed for fastpoly and float", MathErrorBound);
+			hugePages = parser.add<popl::Value<std::string>>("", "huge-pages", "Dataset pages: off, thp or explicit", "thp");
+		}
+
+		//Throws std::invalid_argument (popl::invalid_option included) on bad options
+		Params Parse(int argc, const char* const argv[])
+		{
+			parser.parse(argc, argv);
+			if (!parser.unknown_options().empty())
+			{
+				throw std::invalid_argument("Unknown option " + parser.unknown_options().front());
+			}
+			if ((queued->is_set() + atomicQueued->is_set() + continuous->is_set() + stealing->is_set() + hybrid->is_set() + pipelined->is_set() > 1) || (even->is_set() + stacked->is_set() + shape->is_set() > 1))
+			{
+				throw std::invalid_argument("Choose one strategy and one distribution");
+			}
+
+			Params params;
+			params.help = help->is_set();
+			params.strategy = queued->is_set() ? Strategy::Queued : atomicQueued->is_set() ? Strategy::AtomicQueued : continuous->is_set() ? Strategy::Continuous :
+				stealing->is_set() ? Strategy::Stealing : hybrid->is_set() ? Strategy::Hybrid : pipelined->is_set() ? Strategy::Pipelined : Strategy::Preassigned;
+			params.distribution = even->is_set() ? Distribution::Even : stacked->is_set() ? Distribution::Stacked : Distribution::Random;
+			if (shape->is_set())
+			{
+				const auto it = std::ranges::find(Shapes, std::string_view{ shape->value() }, &std::pair<std::string_view, Distribution>::first);
+				if (it == Shapes.end())
+				{
+					throw std::invalid_argument("Unknown shape " + shape->value());
+				}
+				params.distribution = it->second;
+			}
+			params.stress = stress->is_set();
+			if (writeDataset->is_set())
+			{
+				params.writeDataset = writeDataset->value();
+			}
+			if (dataset->is_set())
+			{
+				params.dataset = dataset->value();
+			}
+			params.verifyDataset = verifyDataset->is_set();
+			params.streamed = streamed->is_set();
+			params.claimBench = claimBench->is_set();
+			params.sharingBench = sharingBench->is_set();
+			params.dispatchBench = dispatchBench->is_set();
+			params.demos = demos->is_set();
+			if (const auto it = std::ranges::find(Claims, std::string_view{ claim->value() }, &std::pair<std::string_view, Claim>::first); it != Claims.end())
+			{
+				params.claim = it->second;
+			}
+			else
+			{
+				throw std::invalid_argument("Unknown claim policy " + claim->value());
+			}
+			if (staticFraction->value() != "auto")
+			{
+				size_t used = 0;
+				try {
+					params.staticFraction = std::stod(staticFraction->value(), &used);
+				}
+				catch (const std::logic_error&)
+				{
+				}
+				if (!params.staticFraction || used != staticFraction->value().size() || !(*params.staticFraction >= 0. && *params.staticFraction <= 1.))
+				{
+					throw std::invalid_argument("Static fraction must be auto or within [0, 1]");
+				}
+			}
+			params.workers = workers->value();
+			params.chunkSize = chunkSize->value();
+			params.chunkCount = chunkCount->value();
+			params.probabilityHeavy = probabilityHeavy->value();
+			params.seed = seed->value();
+			params.lightIterations = lightIterations->value();
+			params.heavyIterations = heavyIterations->value();
+			if (layout->value() == "soa")
+			{
+				params.layout = dsf::Layout::Soa;
+			}
+			else if (layout->value() != "aos")
+			{
+				throw std::invalid_argument("Layout must be aos or soa");
+			}
+			if (const auto it = std::ranges::find(Maths, std::string_view{ math->value() }, &std::pair<std::string_view, Math>::first); it != Maths.end())
+			{
+				params.math = it->second;
+			}
+			else
+			{
+				throw std::invalid_argument("Unknown math policy " + math->value());
+			}
+			params.errorBound = errorBound->value();
+			if (hugePages->value() == "off")
+			{
+				params.hugePages = mem::HugePages::Off;
+			}
+			else if (hugePages->value() == "explicit")
+			{
+				params.hugePages = mem::HugePages::Explicit;
+			}
+			else if (hugePages->value() != "thp")
+			{
+				throw std::invalid_argument("Huge pages must be off, thp or explicit");
+			}
+
+			if (params.chunkSize == 0 || params.lightIterations == 0 || params.heavyIterations == 0)
+			{
+				throw std::invalid_argument("Chunk size and iteration counts must be at least 1");
+			}
+			if (!(params.probabilityHeavy >= 0. && params.probabilityHeavy <= 1.))
+			{
+				throw std::invalid_argument("Heavy probability must be within [0, 1]");
+			}
+			if (!(params.errorBound >= 0.))
+			{
+				throw std::invalid_argument("Error bound must be at least 0");
+			}
+			if (params.layout == dsf::Layout::Soa && (params.stress || params.chunkSize != ChunkSize || Costed(params.distribution)))
+			{
+				throw std::invalid_argument("SoA chunks hold heavy / light tasks of the compiled chunk size, one shape at a time");
+			}
+			if (math->is_set() && params.math != Math::Libm && (!params.Specialized() || Costed(params.distribution)))
+			{
+				throw std::invalid_argument("fastpoly and float run heavy / light chunks of the compiled chunk size and trip counts");
+			}
+			if (params.verifyDataset && !params.dataset)
+			{
+				throw std::invalid_argument("--verify-dataset checks a --dataset file");
+			}
+			if (params.writeDataset || params.dataset)
+			{
+				//Files hold the compiled Chunk type
+				if (params.writeDataset && params.dataset)
+				{
+					throw std::invalid_argument("Choose one of --write-dataset and --dataset");
+				}
+				if (params.stress || params.chunkSize != ChunkSize || Costed(params.distribution))
+				{
+					throw std::invalid_argument("Dataset files hold heavy / light chunks of the compiled chunk size, one shape at a time");
+				}
+				if (params.dataset && (even->is_set() || stacked->is_set() || shape->is_set() || seed->is_set()))
+				{
+					throw std::invalid_argument("A dataset file brings its own shape and seed");
+				}
+			}
+			if (params.strategy == Strategy::Pipelined && (params.dataset || params.writeDataset || params.streamed || params.layout != dsf::Layout::Aos || !params.Specialized() || !CounterBased(params.distribution)))
+			{
+				throw std::invalid_argument("Pipelined generates random, even or stacked AoS chunks of the compiled chunk size and trip counts itself");
+			}
+			if (params.streamed)
+			{
+				//Chunks come in order and only a few exist at a time
+				if (params.strategy == Strategy::Continuous)
+				{
+					throw std::invalid_argument("Continuous indexes chunks out of order, it can't run on streamed chunks");
+				}
+				if (params.writeDataset || params.stress || params.chunkSize != ChunkSize || (!params.dataset && !CounterBased(params.distribution)))
+				{
+					throw std::invalid_argument("Streamed chunks are random, even or stacked chunks of the compiled chunk size, or come from --dataset");
+				}
+			}
+			return params;
+		}
+
+		std::string Help() const
+		{
+			return parser.help();
+		}
+
+	private:
+		popl::OptionParser parser;
+		std::shared_ptr<popl::Switch> help;
+		std::shared_ptr<popl::Switch> queued;
+		std::shared_ptr<popl::Switch> atomicQueued;
+		std::shared_ptr<popl::Switch> continuous;
+		std::shared_ptr<popl::Switch> stealing;
+		std::shared_ptr<popl::Switch> hybrid;
+		std::shared_ptr<popl::Switch> pipelined;
+		std::shared_ptr<popl::Value<std::string>> staticFraction;
+		std::shared_ptr<popl::Switch> even;
+		std::shared_ptr<popl::Switch> stacked;
+		std::shared_ptr<popl::Value<std::string>> shape;
+		std::shared_ptr<popl::Switch> stress;
+		std::shared_ptr<popl::Value<std::string>> writeDataset;
+		std::shared_ptr<popl::Value<std::string>> dataset;
+		std::shared_ptr<popl::Switch> verifyDataset;
+		std::shared_ptr<popl::Switch> streamed;
+		std::shared_ptr<popl::Switch> claimBench;
+		std::shared_ptr<popl::Switch> sharingBench;
+		std::shared_ptr<popl::Switch> dispatchBench;
+		std::shared_ptr<popl::Switch> demos;
+		std::shared_ptr<popl::Value<std::string>> claim;
+		std::shared_ptr<popl::Value<size_t>> workers;
+		std::shared_ptr<popl::Value<size_t>> chunkSize;
+		std::shared_ptr<popl::Value<size_t>> chunkCount;
+		std::shared_ptr<popl::Value<double>> probabilityHeavy;
+		std::shared_ptr<popl::Value<uint64_t>> seed;
+		std::shared_ptr<popl::Value<size_t>> lightIterations;
+		std::shared_ptr<popl::Value<size_t>> heavyIterations;
+		std::shared_ptr<popl::Value<std::string>> layout;
+		std::shared_ptr<popl::Value<std::string>> math;
+		std::shared_ptr<popl::Value<double>> errorBound;
+		std::shared_ptr<popl::Value<std::string>> hugePages;
+	};
+
+	//Random, even and stacked chunks come from the counter-based streams, filled in parallel.
+	//The other shapes carry state from task to task and chunk to chunk, so they fill on one thread
+	template<typename Data>
+	Data Generate(const Params& params, Data chunks)
+	{
+		const auto seed = gen::Seed(params.seed);
+		switch (params.distribution)
+		{
+		case Distribution::Even:
+			rng::Fill<rng::EvenTask>(chunks, params.seed, params.probabilityHeavy);
+			break;
+		case Distribution::Stacked:
+			rng::Fill<rng::StackedTask>(chunks, params.seed, params.probabilityHeavy);
+			break;
+		case Distribution::Bursty:
+			gen::FillBursty(chunks, .1, .4, params.probabilityHeavy, seed);
+			break;
+		case Distribution::Drifting:
+			gen::FillDrifting(chunks, 0., 2. * params.probabilityHeavy, seed);
+			break;
+		case Distribution::Clustered:
+			gen::FillClustered(chunks, 50., params.probabilityHeavy, seed);
+			break;
+		case Distribution::AdversarialPreassigned:
+			gen::FillAdversarialPreassigned(chunks, tk::DefaultWorkerCount(), params.probabilityHeavy, seed);
+			break;
+		case Distribution::AdversarialTail:
+			gen::FillAdversarialTail(chunks, params.probabilityHeavy, seed);
+			break;
+		default:
+			rng::Fill<rng::RandomTask>(chunks, params.seed, params.probabilityHeavy);
+			break;
+		}
+		return chunks;
+	}
+
+	//f.template operator()<P>() with the atq::claim policy P that claim names
+	template<typename F>
+	int WithClaim(Claim claim, F&& f)
+	{
+		switch (claim)
+		{
+		case Claim::Single:
+			return f.template operator()<atq::claim::Single>();
+		case Claim::Fixed:
+			return f.template operator()<atq::claim::Fixed<FixedClaimSize>>();
+		case Claim::Factoring:
+			return f.template operator()<atq::claim::Factoring>();
+		case Claim::Trapezoid:
+			return f.template operator()<atq::claim::Trapezoid>();
+		default:
+			return f.template operator()<atq::claim::Guided>();
+		}
+	}
+
+	//The budgeted worker count, less the threads that produce the chunks (see buf::Source), at least one
+	template<typename Data>
+	size_t WorkerCountFor()
+	{
+		const auto workers = tk::DefaultWorkerCount();
+		if constexpr (requires { Data::ProducerThreads; })
+		{
+			return std::max(workers, Data::ProducerThreads + 1) - Data::ProducerThreads;
+		}
+		return workers;
+	}
+
+	template<Workload W, typename Data>
+	int RunStrategy(const Params& params, Data chunks, W workload = W{})
+	{
+		const auto workerCount = WorkerCountFor<Data>();
+		switch (params.strategy)
+		{
+		case Strategy::Queued:
+			return que::Experiment<W>(std::move(chunks), workerCount, std::move(workload));
+		case Strategy::AtomicQueued:
+			return WithClaim(params.claim, [&]<atq::claim::Policy P>() {return atq::Experiment<W, P>(std::move(chunks), workerCount, std::move(workload)); });
+		case Strategy::Continuous:
+			if constexpr (requires { chunks[size_t(0)]; })
+			{
+				return WithClaim(params.claim, [&]<atq::claim::Policy P>() {return con::Experiment<W, P>(std::move(chunks), workerCount, ContinuousWindow, std::move(workload)); });
+			}
+			else
+			{
+				throw std::invalid_argument("Continuous needs random access to the chunks");
+			}
+		case Strategy::Stealing:
+			return stw::Experiment<W>(std::move(chunks), workerCount, std::move(workload));
+		case Strategy::Hybrid:
+			return WithClaim(params.claim, [&]<atq::claim::Policy P>() {return hyb::Experiment<W, P>(std::move(chunks), workerCount, params.staticFraction, std::move(workload)); });
+		default:
+			return pre::Experiment<W>(std::move(chunks), workerCount, std::move(workload));
+		}
+	}
+
+	//Continuous-cost shapes, trip counts drawn around the compiled LightIterations
+	inline gen::CostedDataset GenerateCosted(const Params& params)
+	{
+		auto chunks = gen::MakeCostedDataset(params.chunkCount, params.chunkSize);
+		const auto seed = gen::Seed(params.seed);
+		if (params.distribution == Distribution::Zipf)
+		{
+			gen::FillZipf(chunks, 1.1, HeavyIterations / LightIterations, seed);
+		}
+		else
+		{
+			gen::FillLogNormal(chunks, double(LightIterations), 1., 10 * HeavyIterations, seed);
+		}
+		return chunks;
+	}
+
+	//f.template operator()<M>() with the math::Policy M that math names
+	template<typename F>
+	decltype(auto) WithMath(Math math, F&& f)
+	{
+		switch (math)
+		{
+		case Math::FastPoly:
+			return f.template operator()<math::FastPoly>();
+		case Math::Float:
+			return f.template operator()<math::Float>();
+		default:
+			return f.template operator()<math::Libm>();
+		}
+	}
+
+	//f.template operator()<Make>() with the rng task function of a CounterBased distribution
+	template<typename F>
+	decltype(auto) WithTaskFunction(Distribution distribution, F&& f)
+	{
+		switch (distribution)
+		{
+		case Distribution::Even:
+			return f.template operator()<rng::EvenTask>();
+		case Distribution::Stacked:
+			return f.template operator()<rng::StackedTask>();
+		default:
+			return f.template operator()<rng::RandomTask>();
+		}
+	}
+
+	//f.template operator()<C>() with the chunk type of layout, Chunk or SoaChunk
+	template<typename F>
+	decltype(auto) WithLayout(dsf::Layout layout, F&& f)
+	{
+		if (layout == dsf::Layout::Soa)
+		{
+			return f.template operator()<SoaChunk>();
+		}
+		return f.template operator()<Chunk>();
+	}
+
+	//Chunks of the compiled size as a Dataset (C = Chunk) or an SoaDataset (C = SoaChunk). Counter-based shapes
+	//fill either layout directly, the others only fill Task chunks and are converted
+	template<typename C>
+	mem::Vector<C> GenerateChunks(const Params& params)
+	{
+		if constexpr (std::is_same_v<C, SoaChunk>)
+		{
+			if (CounterBased(params.distribution))
+			{
+				return WithTaskFunction(params.distribution, [&]<rng::TaskFunction Make>() {return rng::Generate<SoaDataset, Make>(params.seed, params.chunkCount, params.probabilityHeavy); });
+			}
+			return ToSoa(Generate(params, Dataset(params.chunkCount)));
+		}
+		else
+		{
+			return Generate(params, Dataset(params.chunkCount));
+		}
+	}
+
+	//Generated chunks -> file, in the chosen layout. The counter-based shapes go a chunk at a time, so the
+	//dataset never has to fit in memory, the others are generated whole first
+	inline void WriteDataset(const Params& params, const std::filesystem::path& path)
+	{
+		Timer timer;
+		WithLayout(params.layout, [&]<typename C>()
+		{
+			if (CounterBased(params.distribution))
+			{
+				WithTaskFunction(params.distribution, [&]<rng::TaskFunction Make>()
+				{
+					dsf::Writer<C> writer{ path };
+					const auto chunk = std::make_unique<C>();
+					for (size_t c = 0; c < params.chunkCount; c++)
+					{
+						rng::FillChunk<Make>(*chunk, c, params.seed, params.probabilityHeavy);
+						writer.Append(*chunk);
+					}
+					writer.Close();
+				});
+			}
+			else
+			{
+				dsf::Write(path, GenerateChunks<C>(params));
+			}
+		});
+		std::cout << std::format("Wrote {} chunks to {} in {} seconds\n", params.chunkCount, path.string(), timer.Peek());
+	}
+
+	//Maps the --dataset file, checked against its checksum first with --verify-dataset
+	template<typename C>
+	dsf::MappedDataset<C> OpenDataset(const Params& params, size_t window = 0)
+	{
+		dsf::MappedDataset<C> file{ *params.dataset, window };
+		if (params.verifyDataset)
+		{
+			Timer timer;
+			if (!file.VerifyChecksum())
+			{
+				throw std::runtime_error("Dataset file checksum mismatch: " + params.dataset->string());
+			}
+			std::cout << "Verifying took " << timer.Peek() << " seconds\n";
+		}
+		return file;
+	}
+
+	//Builds the dataset with generate(), timed apart from the processing
+	template<typename F>
+	auto TimeGeneration(F&& generate)
+	{
+		Timer timer;
+		auto chunks = generate();
+		std::cout << "Generating took " << timer.Peek() << " seconds\n";
+		return chunks;
+	}
+
+	//Task chunks of the compiled size, through the tuned kernels under the chosen math when the trip counts match too
+	template<typename Data>
+	int RunTasks(const Params& params, Data chunks)
+	{
+		if (params.Specialized())
+		{
+			return WithMath(params.math, [&]<math::Policy M>() {return RunStrategy(params, std::move(chunks), TaskWorkload<M>{ params.errorBound }); });
+		}
+		return RunStrategy(params, std::move(chunks), RuntimeTaskWorkload{ params.lightIterations, params.heavyIterations });
+	}
+
+	//Runs the configured experiment, call from outside the runtime's workers
+	inline int Run(const Params& params)
+	{
+		tk::SetWorkerCountOverride(params.workers);
+		mem::SetHugePageMode(params.hugePages);
+		if (params.claimBench)
+		{
+			tk::BenchmarkClaims(std::cout);
+			return 0;
+		}
+		if (params.sharingBench)
+		{
+			tk::BenchmarkFalseSharing(std::cout);
+			return 0;
+		}
+		if (params.dispatchBench)
+		{
+			tk::BenchmarkDispatch(std::cout);
+			return 0;
+		}
+		if (params.strategy == Strategy::Pipelined)
+		{
+			return WithTaskFunction(params.distribution, [&]<rng::TaskFunction Make>()
+			{
+				return WithMath(params.math, [&]<math::Policy M>()
+				{
+					return pip::Experiment<M, Make>(tk::DefaultWorkerCount(), params.chunkCount, params.seed, params.probabilityHeavy, params.errorBound);
+				});
+			});
+		}
+		if (params.writeDataset)
+		{
+			WriteDataset(params, *params.writeDataset);
+			return 0;
+		}
+		if (params.dataset && params.streamed)
+		{
+			//Copied out of the file a chunk at a time, Load drops each record once copied
+			return WithLayout(params.layout, [&]<typename C>() {return RunTasks(params, buf::Load(OpenDataset<C>(params))); });
+		}
+		if (params.dataset)
+		{
+			return WithLayout(params.layout, [&]<typename C>() {return RunTasks(params, OpenDataset<C>(params, DatasetWindow)); });
+		}
+		if (params.streamed)
+		{
+			return WithLayout(params.layout, [&]<typename C>()
+			{
+				return WithTaskFunction(params.distribution, [&]<rng::TaskFunction Make>()
+				{
+					return RunTasks(params, buf::Generate<C, Make>(params.seed, params.chunkCount, params.probabilityHeavy));
+				});
+			});
+		}
+		if (params.stress)
+		{
+			int result = 0;
+			for (const auto& [shapeName, distribution] : Shapes)
+			{
+				for (const auto& [strategyName, strategy] : Strategies)
+				{
+					std::cout << std::format("== {} / {} ==\n", shapeName, strategyName);
+					auto single = params;
+					single.stress = false;
+					single.distribution = distribution;
+					single.strategy = strategy;
+					result |= Run(single);
+				}
+			}
+			return result;
+		}
+		if (Costed(params.distribution))
+		{
+			return RunStrategy<gen::CostedWorkload>(params, TimeGeneration([&] {return GenerateCosted(params); }));
+		}
+		if (params.Specialized() || params.layout == dsf::Layout::Soa)
+		{
+			return WithLayout(params.layout, [&]<typename C>() {return RunTasks(params, TimeGeneration([&] {return GenerateChunks<C>(params); })); });
+		}
+		std::cout << "Chunk size / trip counts differ from Constants.h, running the runtime-sized path\n";
+		return RunStrategy(params, TimeGeneration([&] {return Generate(params, RuntimeDataset(params.chunkCount, RuntimeChunk(params.chunkSize))); }),
+			RuntimeTaskWorkload{ params.lightIterations, params.heavyIterations });
+	}
+}
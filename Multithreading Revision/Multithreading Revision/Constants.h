@@ -1,14 +1,26 @@
 #pragma once
 
 constexpr bool timingMeasurementEnabled = true;
-constexpr size_t WorkerCount = 4;
+constexpr bool allocationProfilingEnabled = false;
+constexpr bool simdKernelEnabled = false; //Polynomial sin/cos, not guaranteed bit-identical to libm (see SimdKernel.h)
+constexpr bool jumpTableEnabled = false; //Heavy/light tasks become table lookups after the first step (see JumpTable.h)
+constexpr bool epochDispatchEnabled = true; //Chunks start with one atomic broadcast and finish on an atomic latch (see Epoch.h)
+constexpr size_t WorkerCount = 4; //Fallback when the CPU budget can't be detected, experiments size from tk::DefaultWorkerCount()
+constexpr size_t DispatchSpin = 256; //Polls before a dispatch wait sleeps when there is more than one CPU, 0 sleeps straight away
+constexpr size_t StealGrain = 32; //Tasks a worker takes from its own range at a time when stealing (see Stealing.h)
+constexpr double HybridStaticFraction = .8; //Share of each chunk hyb preassigns before it adapts (see Hybrid.h)
+constexpr double HybridMaxStaticFraction = .95; //Adapted shares stay below this, so some tail is always dynamic
+constexpr size_t ContinuousWindow = 4; //Chunks open at once in continuous mode (see Continuous.h)
+constexpr size_t DatasetWindow = 8; //Chunks of a mapped dataset file kept resident while an experiment runs on it (see DatasetFile.h)
+constexpr size_t ClaimGroupWorkers = 8; //Workers sharing one claim counter in que / atq (see ShardedRange.h)
 constexpr size_t ChunkSize = 8'000;
 constexpr size_t ChunkCount = 100;
-constexpr size_t SubsetSize = ChunkSize / WorkerCount;
 constexpr size_t LightIterations = 100;
 constexpr size_t HeavyIterations = 1'000;
 
 constexpr double ProbabilityHeavy = .05;
+constexpr double MathErrorBound = .01; //Relative error on the aggregate result allowed for inexact math policies, --error-bound sets it per run
 
 static_assert(ChunkSize >= WorkerCount);
-static_assert(ChunkSize% WorkerCount == 0);
+static_assert(LightIterations >= 1 && HeavyIterations >= 1);
+
@@ -0,0 +1,188 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "Runtime.h"
+#include "Workload.h"
+#include "ShardedRange.h"
+#include "AtomicQueue.h"
+#include "Engine.h"
+
+//No barrier between chunks: the main thread keeps a window of chunks open and a worker that finds nothing
+//left to claim in one chunk moves straight on to the next, so workers only idle at the end of the run (or
+//when they get a whole window ahead of the slowest chunk). Claims work as in atq, per chunk.
+//Runs on eng::Engine as a continuous distribution, the engine starts the workers once for the whole run
+namespace con
+{
+	template<atq::claim::Policy Claim>
+	struct Distribution
+	{
+		template<typename View, Workload W>
+		class For
+		{
+		public:
+			For(size_t workerCount, size_t window)
+				:
+				workerCount{ workerCount }
+			{
+				for (size_t i = 0; i < std::max<size_t>(window, 1); i++)
+				{
+					slots.push_back(std::make_unique<Slot>(workerCount));
+				}
+			}
+
+			//Call before starting the workers
+			void Begin(size_t count)
+			{
+				chunkCount = count;
+				published = 0;
+				collected = 0;
+				lastCompletion = std::chrono::steady_clock::now();
+			}
+
+			//Opens chunk k once chunk k - window is collected. Main thread only, chunks in order
+			template<typename Done>
+			void Publish(size_t k, View chunk, Done&& done)
+			{
+				if (k >= slots.size())
+				{
+					Collect_(k - slots.size(), done);
+				}
+				auto& slot = *slots[k % slots.size()];
+				{
+					std::lock_guard lk{ mtx };
+					slot.ranges.Reset(chunk.size());
+					slot.chunk = chunk;
+					slot.left = 0;
+					published = k + 1;
+				}
+				cv.notify_all();
+			}
+
+			//Collects the chunks still open. Main thread only, after the last Publish
+			template<typename Done>
+			void Drain(Done&& done)
+			{
+				while (collected < published)
+				{
+					Collect_(collected, done);
+				}
+			}
+
+			template<typename Sink>
+			void Process(size_t worker, Sink& sink)
+			{
+				const auto home = slots.front()->ranges.HomeGroup(worker);
+				for (size_t k = 0; auto* pSlot = Enter_(k); k++)
+				{
+					sink.BeginChunk(k);
+					size_t group = home;
+					while (const auto range = pSlot->ClaimRange(group))
+					{
+						sink.Range(*range);
+					}
+					sink.EndChunk(k);
+					Leave_(*pSlot);
+				}
+			}
+
+		private:
+			//One open chunk. Workers claim from ranges and leave once it is used up, the last to leave completes it
+			struct alignas(std::hardware_destructive_interference_size) Slot
+			{
+				Slot(size_t workerCount) : ranges{ workerCount } {}
+
+				std::optional<View> ClaimRange(size_t& group)
+				{
+					const auto range = ranges.template Claim<Claim::fixed>(group, [this](size_t start, size_t total) {return Claim::Size(start, total, ranges.GroupWorkers()); });
+					if (!range)
+					{
+						return {};
+					}
+					return chunk.Subview(range->first, range->second);
+				}
+
+				tk::ShardedRange<> ranges;
+				View chunk;
+
+				//Guarded by the distribution's mutex
+				size_t left = 0;
+				std::chrono::steady_clock::time_point completed;
+			};
+
+			//Waits for chunk k to complete and hands done its chunk time, the time since the completion of the
+			//chunks before it
+			template<typename Done>
+			void Collect_(size_t k, Done&& done)
+			{
+				std::unique_lock lk{ mtx };
+				auto& slot = *slots[k % slots.size()];
+				cv.wait(lk, [&] {return slot.left == workerCount; });
+				const auto completed = std::max(slot.completed, lastCompletion);
+				done(k, std::chrono::duration<float>(completed - lastCompletion).count());
+				lastCompletion = completed;
+				collected = k + 1;
+			}
+
+			//Chunk k once it is open, nullptr past the last chunk
+			Slot* Enter_(size_t k)
+			{
+				std::unique_lock lk{ mtx };
+				cv.wait(lk, [&] {return published > k || k >= chunkCount; });
+				return k < chunkCount ? slots[k % slots.size()].get() : nullptr;
+			}
+
+			void Leave_(Slot& slot)
+			{
+				bool needsNotification = false;
+				{
+					std::lock_guard lk{ mtx };
+					if (++slot.left == workerCount)
+					{
+						slot.completed = std::chrono::steady_clock::now();
+						needsNotification = true;
+					}
+				}
+
+				if (needsNotification)
+				{
+					cv.notify_all();
+				}
+			}
+
+			//Read-mostly
+			size_t workerCount;
+			std::vector<std::unique_ptr<Slot>> slots;
+
+			//Main thread only
+			size_t collected = 0;
+			std::chrono::steady_clock::time_point lastCompletion;
+
+			//Shared Memory, written as chunks open and complete, on its own cache lines
+			alignas(std::hardware_destructive_interference_size) std::condition_variable cv;
+			std::mutex mtx;
+			size_t chunkCount = 0;
+			size_t published = 0; //Chunks [0, published) are open or done
+		};
+	};
+
+	//Runs any Workload on data with random access to its chunks (Dataset, SoaDataset, a mapped file).
+	//Chunk rows overlap in time: a worker can be working on a chunk before the previous one completes, so a
+	//row's idle time can go negative, the idle columns summed over the run are what compares with atq
+	template<Workload W = TaskWorkload<>, atq::claim::Policy Claim = atq::claim::Guided, typename Data>
+		requires requires(const Data& data, size_t k) { data[k]; }
+	int Experiment(Data chunks, size_t workerCount = tk::DefaultWorkerCount(), size_t window = ContinuousWindow, W workload = W{})
+	{
+		return eng::Engine<Distribution<Claim>>::Experiment(std::move(chunks), workerCount, std::move(workload), window);
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <numbers>
+#include <ranges>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "Runtime.h"
+
+//Counter-based generation: task (chunk, i) is a pure function of (seed, chunk, i) through Philox4x32-10,
+//given the chunk size and heavy probability,
+//so chunks can be generated in any order, on any number of threads, or regenerated alone, and always
+//come out bit for bit the same. This is where random, even and stacked chunks come from, the other shapes
+//carry state from task to task and chunk to chunk (see Generators.h).
+namespace rng
+{
+	constexpr uint64_t DefaultSeed = 0x5eed'5eed'5eed'5eedull;
+
+	using Counter = std::array<uint32_t, 4>;
+	using Key = std::array<uint32_t, 2>;
+
+	//Philox4x32 with 10 rounds (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+	constexpr Counter Philox(Counter c, Key k)
+	{
+		constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+		constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+		for (int round = 0; round < 10; round++)
+		{
+			const auto p0 = uint64_t(M0) * c[0];
+			const auto p1 = uint64_t(M1) * c[2];
+			c = {
+				uint32_t(p1 >> 32) ^ c[1] ^ k[0],
+				uint32_t(p1),
+				uint32_t(p0 >> 32) ^ c[3] ^ k[1],
+				uint32_t(p0)
+			};
+			k = { k[0] + W0, k[1] + W1 };
+		}
+		return c;
+	}
+
+	//Known answers from the Random123 reference implementation
+	static_assert(Philox({ 0, 0, 0, 0 }, { 0, 0 }) == Counter{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 });
+	static_assert(Philox({ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff }) == Counter{ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd });
+
+	//Four random words for task i of a chunk
+	inline Counter Draw(uint64_t seed, size_t chunkIndex, size_t i)
+	{
+		return Philox({ uint32_t(i), uint32_t(uint64_t(i) >> 32), uint32_t(chunkIndex), uint32_t(uint64_t(chunkIndex) >> 32) },
+			{ uint32_t(seed), uint32_t(seed >> 32) });
+	}
+
+	//53 random bits -> [0, 1)
+	inline double Unit(uint32_t hi, uint32_t lo)
+	{
+		return double(((uint64_t(hi) << 32) | lo) >> 11) * 0x1.0p-53;
+	}
+
+	//Task functions get the task's place and the chunk's shape, so chunks sized at runtime and any heavy
+	//probability come out of the same streams
+
+	//val uniform in [0, 2pi), heavy with probabilityHeavy
+	inline Task RandomTask(uint64_t seed, size_t chunkIndex, size_t i, size_t, double probabilityHeavy)
+	{
+		const auto r = Draw(seed, chunkIndex, i);
+		return Task{ .val = Unit(r[0], r[1]) * 2. * std::numbers::pi, .heavy = double(r[2]) < probabilityHeavy * 4'294'967'296. };
+	}
+
+	//Random values, every 1 / probabilityHeavy-th task heavy
+	inline Task EvenTask(uint64_t seed, size_t chunkIndex, size_t i, size_t, double probabilityHeavy)
+	{
+		const auto r = Draw(seed, chunkIndex, i);
+		const bool heavy = size_t(double(i + 1) * probabilityHeavy) != size_t(double(i) * probabilityHeavy);
+		return Task{ .val = Unit(r[0], r[1]) * 2. * std::numbers::pi, .heavy = heavy };
+	}
+
+	//Random values, heavy tasks all at the front of the chunk
+	inline Task StackedTask(uint64_t seed, size_t chunkIndex, size_t i, size_t chunkSize, double probabilityHeavy)
+	{
+		const auto r = Draw(seed, chunkIndex, i);
+		return Task{ .val = Unit(r[0], r[1]) * 2. * std::numbers::pi, .heavy = i < size_t(double(chunkSize) * probabilityHeavy) };
+	}
+
+	using TaskFunction = Task(*)(uint64_t seed, size_t chunkIndex, size_t i, size_t chunkSize, double probabilityHeavy);
+
+	//Regenerates one chunk on its own, identical to the same chunk of a full dataset. Any chunk of Tasks,
+	//std::array or sized at runtime
+	template<TaskFunction Make = RandomTask, std::ranges::random_access_range C>
+	void FillChunk(C& chunk, size_t chunkIndex, uint64_t seed = DefaultSeed, double probabilityHeavy = ProbabilityHeavy)
+	{
+		const auto size = std::ranges::size(chunk);
+		for (size_t i = 0; i < size; i++)
+		{
+			chunk[i] = Make(seed, chunkIndex, i, size, probabilityHeavy);
+		}
+	}
+
+	template<TaskFunction Make = RandomTask>
+	void FillChunk(SoaChunk& chunk, size_t chunkIndex, uint64_t seed = DefaultSeed, double probabilityHeavy = ProbabilityHeavy)
+	{
+		for (size_t i = 0; i < ChunkSize; i++)
+		{
+			const auto task = Make(seed, chunkIndex, i, ChunkSize, probabilityHeavy);
+			chunk.val[i] = task.val;
+			chunk.SetHeavy(i, task.heavy);
+		}
+	}
+
+	//Fills every chunk, spread over the runtime, call from outside its workers. Data is a Dataset, an
+	//SoaDataset or a vector of chunks sized at runtime, Make one of RandomTask, EvenTask, StackedTask
+	template<TaskFunction Make = RandomTask, typename Data>
+	void Fill(Data& chunks, uint64_t seed = DefaultSeed, double probabilityHeavy = ProbabilityHeavy)
+	{
+		tk::ParallelFor(chunks.size(), [&](size_t c) {FillChunk<Make>(chunks[c], c, seed, probabilityHeavy); });
+	}
+
+	template<typename Data = Dataset, TaskFunction Make = RandomTask>
+	Data Generate(uint64_t seed = DefaultSeed, size_t chunkCount = ChunkCount, double probabilityHeavy = ProbabilityHeavy)
+	{
+		Data chunks(chunkCount);
+		Fill<Make>(chunks, seed, probabilityHeavy);
+		return chunks;
+	}
+}
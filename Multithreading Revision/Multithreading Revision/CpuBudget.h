@@ -0,0 +1,223 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sched.h>
+#endif
+
+#include "Constants.h"
+
+namespace tk
+{
+	//How much CPU the process may actually use, as opposed to how many cores the machine has
+	struct CpuBudget
+	{
+		size_t hardwareThreads = 0;
+		size_t affinityCpus = 0; //sched_getaffinity / process affinity mask
+		size_t cpusetCpus = 0; //cgroup cpuset.cpus.effective, 0 if unrestricted
+		double quotaCpus = 0.; //cgroup cpu.max or job object rate as a number of CPUs, 0 if unlimited
+
+		//Busy workers that fit without CFS throttling or fighting over cores
+		size_t Workers() const
+		{
+			size_t n = affinityCpus ? affinityCpus : hardwareThreads;
+			if (cpusetCpus)
+			{
+				n = std::min(n, cpusetCpus);
+			}
+			if (quotaCpus > 0.)
+			{
+				n = std::min(n, size_t(std::max(1., std::floor(quotaCpus))));
+			}
+			return n ? n : WorkerCount;
+		}
+
+		bool operator == (const CpuBudget&) const = default;
+	};
+
+	namespace detail
+	{
+		//"0-3,8,10-11" -> 7
+		inline size_t CountCpuList(const std::string& list)
+		{
+			size_t count = 0;
+			std::istringstream ss{ list };
+			std::string range;
+			while (std::getline(ss, range, ','))
+			{
+				if (range.empty() || range == "\n")
+				{
+					continue;
+				}
+				const auto dash = range.find('-');
+				try {
+					if (dash == std::string::npos)
+					{
+						std::stoul(range);
+						++count;
+					}
+					else
+					{
+						count += std::stoul(range.substr(dash + 1)) - std::stoul(range.substr(0, dash)) + 1;
+					}
+				}
+				catch (...)
+				{
+				}
+			}
+			return count;
+		}
+
+#ifndef _WIN32
+		inline std::string ReadFirstLine(const std::string& path)
+		{
+			std::ifstream file{ path };
+			std::string line;
+			std::getline(file, line);
+			return line;
+		}
+
+		//cgroup v2 path of this process relative to the unified mount, empty if not on v2
+		inline std::string CgroupV2Path()
+		{
+			std::ifstream file{ "/proc/self/cgroup" };
+			std::string line;
+			while (std::getline(file, line))
+			{
+				if (line.starts_with("0::"))
+				{
+					return line.substr(3);
+				}
+			}
+			return {};
+		}
+
+		//Nested cgroups can each carry a limit, the tightest one along the path wins
+		inline void ReadCgroupV2(CpuBudget& budget)
+		{
+			auto path = CgroupV2Path();
+			if (path.empty())
+			{
+				return;
+			}
+			while (true)
+			{
+				const auto dir = "/sys/fs/cgroup" + path;
+				std::istringstream max{ ReadFirstLine(dir + "/cpu.max") };
+				std::string quota;
+				double period = 0.;
+				try {
+					if (max >> quota >> period && quota != "max" && period > 0.)
+					{
+						const auto cpus = std::stod(quota) / period;
+						budget.quotaCpus = budget.quotaCpus > 0. ? std::min(budget.quotaCpus, cpus) : cpus;
+					}
+				}
+				catch (...)
+				{
+				}
+				if (!budget.cpusetCpus)
+				{
+					budget.cpusetCpus = CountCpuList(ReadFirstLine(dir + "/cpuset.cpus.effective"));
+				}
+				if (path.empty() || path == "/")
+				{
+					break;
+				}
+				path = path.substr(0, path.find_last_of('/'));
+			}
+		}
+
+		inline void ReadCgroupV1(CpuBudget& budget)
+		{
+			const auto quota = ReadFirstLine("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+			const auto period = ReadFirstLine("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+			try {
+				if (!quota.empty() && !period.empty() && std::stol(quota) > 0)
+				{
+					budget.quotaCpus = std::stod(quota) / std::stod(period);
+				}
+			}
+			catch (...)
+			{
+			}
+			if (!budget.cpusetCpus)
+			{
+				budget.cpusetCpus = CountCpuList(ReadFirstLine("/sys/fs/cgroup/cpuset/cpuset.effective_cpus"));
+			}
+		}
+#endif
+	}
+
+	inline CpuBudget DetectCpuBudget()
+	{
+		CpuBudget budget;
+		budget.hardwareThreads = std::thread::hardware_concurrency();
+#ifdef _WIN32
+		DWORD_PTR processMask = 0, systemMask = 0;
+		if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		{
+			budget.affinityCpus = std::popcount(uint64_t(processMask));
+		}
+		//Job objects are the Windows equivalent of a cgroup cpu quota
+		JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate{};
+		if (QueryInformationJobObject(nullptr, JobObjectCpuRateControlInformation, &rate, sizeof(rate), nullptr) &&
+			(rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) && (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP))
+		{
+			//CpuRate is in hundredths of a percent of the whole machine
+			budget.quotaCpus = double(rate.CpuRate) / 10'000. * double(budget.hardwareThreads);
+		}
+#else
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		{
+			budget.affinityCpus = CPU_COUNT(&set);
+		}
+		detail::ReadCgroupV2(budget);
+		if (budget.quotaCpus == 0. && !budget.cpusetCpus)
+		{
+			detail::ReadCgroupV1(budget);
+		}
+#endif
+		return budget;
+	}
+
+	namespace detail
+	{
+		inline std::atomic<size_t> workerOverride = 0;
+		inline std::atomic<size_t> budgetWorkers = 0;
+	}
+
+	//Pins the worker count chosen for experiments, 0 goes back to the detected budget
+	inline void SetWorkerCountOverride(size_t workers)
+	{
+		detail::workerOverride = workers;
+	}
+
+	//Worker count experiments should use right now
+	inline size_t DefaultWorkerCount()
+	{
+		if (const auto forced = detail::workerOverride.load())
+		{
+			return forced;
+		}
+		if (const auto cached = detail::budgetWorkers.load())
+		{
+			return cached;
+		}
+		return DetectCpuBudget().Workers();
+	}
+}
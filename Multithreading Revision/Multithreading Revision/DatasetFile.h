@@ -0,0 +1,436 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+
+//On-disk datasets. A 64 byte header, then one record per chunk at a fixed page-aligned stride:
+//a record is the in-memory Chunk or SoaChunk byte for byte (padding zeroed), so a mapped record is
+//used in place. MappedDataset can keep only a sliding window of chunks resident, so datasets far
+//larger than RAM stream through the engines.
+namespace dsf
+{
+	constexpr std::array<char, 8> Magic{ 'M', 'T', 'R', 'D', 'S', 'E', 'T', '\0' };
+	constexpr uint32_t Version = 1;
+	constexpr uint64_t RecordAlignment = 4096;
+
+	enum class Layout : uint32_t
+	{
+		Aos = 0,
+		Soa = 1,
+	};
+
+	struct Header
+	{
+		std::array<char, 8> magic = Magic;
+		uint32_t version = Version;
+		Layout layout = Layout::Aos;
+		uint64_t chunkSize = ChunkSize;
+		uint64_t chunkCount = 0;
+		uint64_t recordBytes = 0; //Stride between chunk records
+		uint64_t dataOffset = RecordAlignment; //First record
+		uint64_t checksum = 0; //Over all records
+		uint64_t headerChecksum = 0; //Over the fields above
+	};
+	static_assert(std::is_trivially_copyable_v<Header> && sizeof(Header) == 64);
+
+	template<typename C>
+	struct ChunkLayout;
+
+	template<>
+	struct ChunkLayout<Chunk>
+	{
+		static constexpr Layout layout = Layout::Aos;
+	};
+
+	template<>
+	struct ChunkLayout<SoaChunk>
+	{
+		static constexpr Layout layout = Layout::Soa;
+	};
+
+	template<typename C>
+	constexpr uint64_t RecordBytes = (sizeof(C) + RecordAlignment - 1) / RecordAlignment * RecordAlignment;
+
+	namespace detail
+	{
+		//Word at a time multiply-rotate hash, fast enough to checksum at disk speed
+		inline uint64_t Hash(const std::byte* data, size_t bytes, uint64_t h = 0x9E3779B97F4A7C15ull)
+		{
+			size_t i = 0;
+			for (; i + 8 <= bytes; i += 8)
+			{
+				uint64_t word;
+				std::memcpy(&word, data + i, 8);
+				h = std::rotl((h ^ word) * 0xFF51AFD7ED558CCDull, 29);
+			}
+			for (; i < bytes; i++)
+			{
+				h = std::rotl((h ^ uint64_t(data[i])) * 0xFF51AFD7ED558CCDull, 29);
+			}
+			return h ^ (h >> 32);
+		}
+
+		inline uint64_t HeaderChecksum(Header header)
+		{
+			header.headerChecksum = 0;
+			return Hash(reinterpret_cast<const std::byte*>(&header), sizeof(header));
+		}
+
+		//Writes the chunk into a zeroed record member by member, so no indeterminate padding reaches the file
+		inline void Store(std::byte* record, const Chunk& chunk)
+		{
+			auto* out = new (record) Chunk;
+			for (size_t i = 0; i < ChunkSize; i++)
+			{
+				(*out)[i].val = chunk[i].val;
+				(*out)[i].heavy = chunk[i].heavy;
+			}
+		}
+
+		inline void Store(std::byte* record, const SoaChunk& chunk)
+		{
+			auto* out = new (record) SoaChunk;
+			out->val = chunk.val;
+			out->heavy = chunk.heavy;
+		}
+	}
+
+	//Appends chunks one at a time, so a dataset never has to be in memory to be written
+	template<typename C>
+	class Writer
+	{
+	public:
+		explicit Writer(const std::filesystem::path& path)
+			:
+			file{ path, std::ios::binary | std::ios::trunc }
+		{
+			if (!file)
+			{
+				throw std::runtime_error("Cannot create dataset file " + path.string());
+			}
+			header.layout = ChunkLayout<C>::layout;
+			header.recordBytes = RecordBytes<C>;
+			WriteHeader_();
+		}
+		Writer(const Writer&) = delete;
+		Writer& operator = (const Writer&) = delete;
+
+		void Append(const C& chunk)
+		{
+			std::fill(record->begin(), record->end(), std::byte{ 0 });
+			detail::Store(record->data(), chunk);
+			header.checksum = detail::Hash(record->data(), record->size(), header.checksum);
+			file.write(reinterpret_cast<const char*>(record->data()), std::streamsize(record->size()));
+			++header.chunkCount;
+		}
+
+		//Finalizes the header, the file is only valid after this. A writer destroyed without Close (say on an
+		//exception partway through) leaves the placeholder header, which readers reject
+		void Close()
+		{
+			header.headerChecksum = detail::HeaderChecksum(header);
+			file.seekp(0);
+			WriteHeader_();
+			file.close();
+			if (!file)
+			{
+				throw std::runtime_error("Failed writing dataset file");
+			}
+		}
+
+	private:
+		void WriteHeader_()
+		{
+			std::array<std::byte, RecordAlignment> page{};
+			std::memcpy(page.data(), &header, sizeof(header));
+			file.write(reinterpret_cast<const char*>(page.data()), std::streamsize(page.size()));
+		}
+
+		struct alignas(RecordAlignment) Record : std::array<std::byte, RecordBytes<C>> {};
+
+		std::ofstream file;
+		Header header;
+		std::unique_ptr<Record> record = std::make_unique<Record>();
+	};
+
+	//Dataset or SoaDataset -> file
+	template<typename Data>
+	void Write(const std::filesystem::path& path, const Data& chunks)
+	{
+		Writer<typename Data::value_type> writer{ path };
+		for (const auto& chunk : chunks)
+		{
+			writer.Append(chunk);
+		}
+		writer.Close();
+	}
+
+	//Read-only, zero-copy view of a dataset file, usable wherever a Dataset / SoaDataset is (C says which).
+	//Copies share the mapping. With a window, iterating keeps roughly that many chunks resident: the ones ahead
+	//are prefetched and the ones behind are dropped from the working set (they stay in the page cache).
+	template<typename C>
+	class MappedDataset
+	{
+	public:
+		using value_type = C;
+
+		class Iterator
+		{
+		public:
+			using value_type = C;
+			using difference_type = std::ptrdiff_t;
+
+			Iterator() = default;
+			Iterator(const MappedDataset* pSet, size_t i) : pSet{ pSet }, i{ i } {}
+			const C& operator * () const
+			{
+				return (*pSet)[i];
+			}
+			Iterator& operator ++ ()
+			{
+				++i;
+				return *this;
+			}
+			Iterator operator ++ (int)
+			{
+				auto old = *this;
+				++i;
+				return old;
+			}
+			bool operator == (const Iterator&) const = default;
+
+		private:
+			const MappedDataset* pSet = nullptr;
+			size_t i = 0;
+		};
+
+		explicit MappedDataset(const std::filesystem::path& path, size_t window = 0)
+			:
+			mapping{ std::make_shared<Mapping>(path) },
+			window{ window }
+		{
+			if (mapping->bytes < sizeof(Header))
+			{
+				throw std::runtime_error("Dataset file too small: " + path.string());
+			}
+			std::memcpy(&header, mapping->base, sizeof(header));
+			if (header.magic != Magic || header.headerChecksum != detail::HeaderChecksum(header))
+			{
+				throw std::runtime_error("Not a dataset file or corrupt header: " + path.string());
+			}
+			if (header.version != Version || header.layout != ChunkLayout<C>::layout ||
+				header.chunkSize != ChunkSize || header.recordBytes != RecordBytes<C>)
+			{
+				throw std::runtime_error("Dataset file does not match this build (version, layout or chunk size): " + path.string());
+			}
+			if (header.dataOffset + header.chunkCount * header.recordBytes > mapping->bytes)
+			{
+				throw std::runtime_error("Dataset file truncated: " + path.string());
+			}
+		}
+
+		size_t size() const
+		{
+			return size_t(header.chunkCount);
+		}
+
+		//Entering chunk i moves the window, by index as well as by iterator
+		const C& operator[](size_t i) const
+		{
+			Advise_(i);
+			return *std::launder(reinterpret_cast<const C*>(Record_(i)));
+		}
+
+		Iterator begin() const
+		{
+			return { this, 0 };
+		}
+
+		Iterator end() const
+		{
+			return { this, size() };
+		}
+
+		const Header& GetHeader() const
+		{
+			return header;
+		}
+
+		//Reads every record, for 100+ GB files that is a full pass over the disk (pages are dropped as it goes)
+		bool VerifyChecksum() const
+		{
+			uint64_t checksum = 0;
+			for (size_t i = 0; i < size(); i++)
+			{
+				checksum = detail::Hash(Record_(i), header.recordBytes, checksum);
+				Release(i);
+			}
+			return checksum == header.checksum;
+		}
+
+		//Drops chunk i's pages from the working set, they are read back in if touched again
+		void Release(size_t i) const
+		{
+			auto* address = const_cast<std::byte*>(Record_(i));
+#ifdef _WIN32
+			//Unlocking pages that were never locked trims them from the working set
+			VirtualUnlock(address, header.recordBytes);
+#else
+			madvise(address, header.recordBytes, MADV_DONTNEED);
+#endif
+		}
+
+	private:
+		struct Mapping
+		{
+			explicit Mapping(const std::filesystem::path& path)
+			{
+#ifdef _WIN32
+				file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+				LARGE_INTEGER size{};
+				if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+				{
+					Unmap_();
+					throw std::runtime_error("Cannot open dataset file " + path.string());
+				}
+				bytes = size_t(size.QuadPart);
+				section = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				base = section ? static_cast<const std::byte*>(MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+				if (!base)
+				{
+					Unmap_();
+					throw std::runtime_error("Cannot map dataset file " + path.string());
+				}
+#else
+				fd = open(path.c_str(), O_RDONLY);
+				struct stat info{};
+				if (fd < 0 || fstat(fd, &info) != 0)
+				{
+					Unmap_();
+					throw std::runtime_error("Cannot open dataset file " + path.string());
+				}
+				bytes = size_t(info.st_size);
+				auto* address = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0); //Fails on an empty file
+				if (address == MAP_FAILED)
+				{
+					Unmap_();
+					throw std::runtime_error("Cannot map dataset file " + path.string());
+				}
+				base = static_cast<const std::byte*>(address);
+#endif
+			}
+			Mapping(const Mapping&) = delete;
+			Mapping& operator = (const Mapping&) = delete;
+			~Mapping()
+			{
+				Unmap_();
+			}
+
+			const std::byte* base = nullptr;
+			size_t bytes = 0;
+#ifdef _WIN32
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE section = nullptr;
+#else
+			int fd = -1;
+#endif
+
+		private:
+			//Whatever was opened so far, also on the constructor's throw paths where the destructor won't run
+			void Unmap_()
+			{
+#ifdef _WIN32
+				if (base)
+				{
+					UnmapViewOfFile(base);
+				}
+				if (section)
+				{
+					CloseHandle(section);
+				}
+				if (file != INVALID_HANDLE_VALUE)
+				{
+					CloseHandle(file);
+				}
+#else
+				if (base)
+				{
+					munmap(const_cast<std::byte*>(base), bytes);
+				}
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+#endif
+			}
+		};
+
+		const std::byte* Record_(size_t i) const
+		{
+			return mapping->base + header.dataOffset + i * header.recordBytes;
+		}
+
+		void Prefetch_(size_t first, size_t count) const
+		{
+			count = std::min(count, size() - std::min(first, size()));
+			if (!count)
+			{
+				return;
+			}
+			auto* address = const_cast<std::byte*>(Record_(first));
+			const auto bytes = count * header.recordBytes;
+#ifdef _WIN32
+			WIN32_MEMORY_RANGE_ENTRY range{ address, bytes };
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+			madvise(address, bytes, MADV_WILLNEED);
+#endif
+		}
+
+		//Entering chunk i: read ahead the next half window, drop the chunk that fell out behind
+		void Advise_(size_t i) const
+		{
+			if (!window)
+			{
+				return;
+			}
+			const auto ahead = std::max<size_t>(window / 2, 1);
+			const auto behind = window - std::min(window, ahead);
+			Prefetch_(i + 1, ahead);
+			if (i > behind)
+			{
+				Release(i - behind - 1);
+			}
+		}
+
+		std::shared_ptr<Mapping> mapping;
+		Header header;
+		size_t window;
+	};
+}
@@ -0,0 +1,532 @@
+#pragma once
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <format>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "Timing.h"
+#include "Timer.h"
+#include "Runtime.h"
+#include "AllocationProfiler.h"
+#include "HugePages.h"
+#include "Workload.h"
+#include "Epoch.h"
+
+//The chunk-by-chunk experiment driver the strategies share: a crew of workers, a barrier per chunk, per-chunk
+//timings and the result check. What varies is a policy each, all resolved at compile time:
+//  Distribution: how a chunk's tasks get to the workers (pre, que, atq, stw, hyb provide one each). A continuous
+//    one (con) drops the barrier and gets the whole run as a single round
+//  Wake: how workers are started on a chunk and counted back in (Handshake, EpochWake)
+//  Timing: whether per-chunk timings are collected and written (Timed, Untimed)
+namespace eng
+{
+	//What a Distribution hands tasks to on a worker: Block for a contiguous share worked through the bulk kernel,
+	//Range for a piece claimed at runtime, fed through the workload's batch
+	template<typename S, typename View>
+	concept TaskSink = requires(S& sink, const View& view)
+	{
+		sink.Block(view);
+		sink.Range(view);
+	};
+
+	namespace detail
+	{
+		template<typename View>
+		struct ProbeSink
+		{
+			void Block(const View&) {}
+			void Range(const View&) {}
+			void BeginChunk(size_t) {}
+			void EndChunk(size_t) {}
+		};
+	}
+
+	//A Distribution family F provides F::For<View, W>, built from the worker count (and whatever the experiment
+	//passes on), with SetChunk(view) on the main thread before a chunk starts and Process(worker, sink) on every
+	//worker. Optional hooks: EndChunk() once all workers are done, Report(out, chunkCount, claims) after the run
+	template<typename D, typename View>
+	concept Distribution = requires(D& d, const View& chunk, size_t worker, detail::ProbeSink<View>& sink)
+	{
+		d.SetChunk(chunk);
+		d.Process(worker, sink);
+	};
+
+	//A continuous Distribution keeps chunks open across the barrier: the workers get one round for the whole run,
+	//Begin(chunkCount) comes before it, then the main thread Publishes chunk k as it goes and Drains what is still
+	//open, both calling done(k, chunkTime) as chunks complete. Process brackets the worker's share of chunk k with
+	//sink.BeginChunk(k) / sink.EndChunk(k), which give it its own timing row
+	template<typename D, typename View>
+	concept ContinuousDistribution = requires(D& d, const View& chunk, size_t k, void(&done)(size_t, float), detail::ProbeSink<View>& sink)
+	{
+		d.Process(k, sink);
+		d.Begin(k);
+		d.Publish(k, chunk, done);
+		d.Drain(done);
+	};
+
+	//Per-worker mutex / cv to start, a locked done count and a cv to finish. Workers hold their mutex while working
+	class Handshake
+	{
+	public:
+		struct alignas(std::hardware_destructive_interference_size) Local
+		{
+			std::condition_variable cv;
+			std::mutex mtx;
+			bool terminate = false;
+			bool working = false;
+		};
+
+		explicit Handshake(size_t workerCount) : workerCount{ workerCount }, lk{ mtx } {}
+
+		template<typename Crew>
+		void Start(Crew& workers)
+		{
+			for (const auto& w : workers)
+			{
+				auto& local = w->WakeLocal();
+				{
+					std::lock_guard lk{ local.mtx };
+					local.working = true;
+				}
+				local.cv.notify_one();
+			}
+		}
+
+		void WaitForAll()
+		{
+			cv.wait(lk, [this] {return doneCount == workerCount; });
+			doneCount = 0;
+		}
+
+		//Worker loop, one round per Start until killed
+		template<typename F>
+		void Run(Local& local, F&& round)
+		{
+			std::unique_lock lk{ local.mtx };
+			while (true)
+			{
+				local.cv.wait(lk, [&] {return local.working || local.terminate; });
+				if (local.terminate)
+				{
+					break;
+				}
+				round();
+				local.working = false;
+				SignalDone_();
+			}
+		}
+
+		void Kill(Local& local)
+		{
+			{
+				std::lock_guard lk{ local.mtx };
+				local.terminate = true;
+			}
+			local.cv.notify_one();
+		}
+
+	private:
+		void SignalDone_()
+		{
+			bool needsNotification = false;
+			{
+				std::lock_guard lk{ mtx };
+				++doneCount;
+				if (doneCount == workerCount)
+				{
+					needsNotification = true;
+				}
+			}
+
+			if (needsNotification)
+			{
+				cv.notify_one();
+			}
+		}
+
+		size_t workerCount;
+
+		//Shared Memory, written as each worker finishes, on its own cache lines
+		alignas(std::hardware_destructive_interference_size) std::condition_variable cv;
+		std::mutex mtx; //Always Mutex with CV
+		std::unique_lock<std::mutex> lk;
+		size_t doneCount = 0;
+	};
+
+	//One atomic broadcast to start, an atomic latch to finish (see tk::Epoch)
+	class EpochWake
+	{
+	public:
+		struct Local
+		{
+		};
+
+		explicit EpochWake(size_t workerCount) : workerCount{ workerCount } {}
+
+		template<typename Crew>
+		void Start(Crew&)
+		{
+			dispatch.Broadcast(workerCount);
+		}
+
+		void WaitForAll()
+		{
+			dispatch.WaitForAll();
+		}
+
+		template<typename F>
+		void Run(Local&, F&& round)
+		{
+			for (uint64_t seen = 0; dispatch.Await(seen); )
+			{
+				round();
+				dispatch.Arrive();
+			}
+		}
+
+		void Kill(Local&)
+		{
+			dispatch.Terminate();
+		}
+
+	private:
+		size_t workerCount;
+		tk::Epoch dispatch; //Its counters sit on their own cache lines
+	};
+
+	using DefaultWake = std::conditional_t<epochDispatchEnabled, EpochWake, Handshake>;
+
+	//A ChunkTimeInfo row per chunk from the workers' work times and heavy counts, written to timings.csv.
+	//Chunk by chunk the main thread fills each row once the workers are done, a continuous run has every worker
+	//Record its own cells and the main thread Complete the row
+	class Timed
+	{
+	public:
+		static constexpr bool enabled = true;
+
+		Timed(size_t workerCount, size_t chunkCount) : workerCount{ workerCount }, timings{ workerCount, chunkCount } {}
+
+		void BeginChunk()
+		{
+			chunkTimer.Mark();
+		}
+
+		template<typename Crew>
+		void EndChunk(Crew& workers)
+		{
+			const auto chunkTime = chunkTimer.Peek();
+			for (size_t i = 0; i < workerCount; i++)
+			{
+				Record(next, i, workers[i]->GetNumHeavy(), workers[i]->GetJobWorkTime());
+			}
+			Complete(next++, chunkTime);
+		}
+
+		void Record(size_t chunk, size_t worker, size_t numHeavy, float workTime)
+		{
+			const auto row = timings[chunk];
+			row.numberOfHeavyPerThread[worker] = numHeavy;
+			row.timeSpentWorkingPerThread[worker] = workTime;
+		}
+
+		void Complete(size_t chunk, float chunkTime)
+		{
+			timings[chunk].totalChunkTime = chunkTime;
+		}
+
+		void Write() const
+		{
+			WriteCSV(timings);
+		}
+
+	private:
+		size_t workerCount;
+		ChunkTimings timings;
+		size_t next = 0;
+		Timer chunkTimer;
+	};
+
+	class Untimed
+	{
+	public:
+		static constexpr bool enabled = false;
+
+		Untimed(size_t, size_t) {}
+		void BeginChunk() {}
+		template<typename Crew>
+		void EndChunk(Crew&) {}
+		void Record(size_t, size_t, size_t, float) {}
+		void Complete(size_t, float) {}
+		void Write() const {}
+	};
+
+	using DefaultTiming = std::conditional_t<timingMeasurementEnabled, Timed, Untimed>;
+
+	template<typename DistributionFamily, typename Wake = DefaultWake, typename Timing = DefaultTiming>
+	class Engine
+	{
+		template<typename View, Workload W>
+		using DistributionOf = typename DistributionFamily::template For<View, W>;
+
+		template<typename View, Workload W>
+		struct Controller
+		{
+			template<typename ...A>
+			Controller(W workload, size_t workerCount, size_t chunkCount, A&& ...args)
+				:
+				workload{ std::move(workload) },
+				distribution{ workerCount, std::forward<A>(args)... },
+				wake{ workerCount },
+				timing{ workerCount, chunkCount }
+			{}
+
+			size_t Register()
+			{
+				return registered++;
+			}
+
+			W workload;
+			DistributionOf<View, W> distribution;
+			Wake wake;
+			Timing timing;
+			size_t registered = 0;
+		};
+
+		//Aligned so neighbouring workers in the crew don't share cache lines
+		template<typename View, Workload W>
+		class alignas(std::hardware_destructive_interference_size) Worker
+		{
+		public:
+			Worker(Controller<View, W>* pWorkerController)
+				:
+				pController{ pWorkerController },
+				index{ pWorkerController->Register() }
+			{}
+
+			void Kill()
+			{
+				pController->wake.Kill(wakeLocal);
+			}
+
+			typename Wake::Local& WakeLocal()
+			{
+				return wakeLocal;
+			}
+
+			typename W::Result GetResult() const
+			{
+				return accululation;
+			}
+
+			float GetJobWorkTime() const
+			{
+				return workTime;
+			}
+
+			size_t GetNumHeavy() const
+			{
+				return numHeavyItems;
+			}
+
+			size_t GetNumClaims() const
+			{
+				return numClaims;
+			}
+
+			~Worker()
+			{
+				Kill();
+			}
+
+			//Worker loop, runs on a runtime thread until killed
+			void Run()
+			{
+				pController->wake.Run(wakeLocal, [this]
+				{
+					Timer timer;
+					ProcessData_();
+					if constexpr (Timing::enabled)
+					{
+						workTime = timer.Peek();
+					}
+				});
+			}
+
+			//Where the distribution's tasks go, one per round
+			class Sink
+			{
+			public:
+				Sink(Worker& worker) : worker{ worker }, workload{ worker.pController->workload }, batch{ work::MakeBatch(workload) } {}
+
+				void Block(const View& block)
+				{
+					worker.accululation = workload.Reduce(worker.accululation, work::ProcessChunk(workload, block));
+					if constexpr (Timing::enabled)
+					{
+						worker.numHeavyItems += work::HeavyCount(workload, block);
+					}
+				}
+
+				void Range(const View& range)
+				{
+					++worker.numClaims;
+					for (size_t i = 0; i < range.size(); i++)
+					{
+						worker.accululation = workload.Reduce(worker.accululation, batch.Push(range[i]));
+					}
+					if constexpr (Timing::enabled)
+					{
+						worker.numHeavyItems += work::HeavyCount(workload, range);
+					}
+				}
+
+				void Flush()
+				{
+					worker.accululation = workload.Reduce(worker.accululation, batch.Flush());
+				}
+
+				//Continuous distributions only, the worker's share of chunk k between the two goes to timing row k
+				void BeginChunk(size_t)
+				{
+					worker.numHeavyItems = 0;
+					if constexpr (Timing::enabled)
+					{
+						chunkTimer.Mark();
+					}
+				}
+
+				void EndChunk(size_t k)
+				{
+					Flush();
+					if constexpr (Timing::enabled)
+					{
+						worker.pController->timing.Record(k, worker.index, worker.numHeavyItems, chunkTimer.Peek());
+					}
+				}
+
+			private:
+				Worker& worker;
+				const W& workload;
+				work::Batch<W> batch;
+				Timer chunkTimer;
+			};
+
+		private:
+			void ProcessData_()
+			{
+				alloc::NoAllocationScope scope{ "chunk.process" };
+				numHeavyItems = 0;
+				numClaims = 0;
+				Sink sink{ *this };
+				pController->distribution.Process(index, sink);
+				sink.Flush();
+			}
+
+			//Read-mostly
+			Controller<View, W>* pController;
+			size_t index;
+
+			//Shared Memory, handed over between the main thread and the worker
+			typename Wake::Local wakeLocal;
+
+			//Written by the worker while processing, read once the chunk is done
+			alignas(std::hardware_destructive_interference_size) typename W::Result accululation = pController->workload.Identity();
+			float workTime = -1.f;
+			size_t numHeavyItems = 0;
+			size_t numClaims = 0;
+		};
+
+	public:
+		//Runs any Workload, Task data as a Dataset or an SoaDataset. args go to the distribution after the worker count
+		template<Workload W, typename Data, typename ...A>
+		static int Experiment(Data chunks, size_t workerCount, W workload, A&& ...args)
+		{
+			using View = ViewOf<Data>;
+			static_assert(Distribution<DistributionOf<View, W>, View> || ContinuousDistribution<DistributionOf<View, W>, View>);
+			static_assert(TaskSink<typename Worker<View, W>::Sink, View>);
+
+			alloc::Scope experimentScope{ "experiment" };
+			work::Prepare(workload);
+			const auto tlbMisses = mem::TlbMisses();
+			Timer totalTime;
+			totalTime.Mark();
+
+			//Create Worker Threads
+			Controller<View, W> controller{ std::move(workload), workerCount, chunks.size(), std::forward<A>(args)... }; //Initialise Controller
+			tk::Crew<Worker<View, W>> workerPtrs{ workerCount, &controller };
+			auto& timing = controller.timing;
+
+			size_t claims = 0;
+			if constexpr (ContinuousDistribution<DistributionOf<View, W>, View>)
+			{
+				//One round for the whole run, the main thread publishes chunks while the workers are in it
+				const auto done = [&](size_t k, float chunkTime) {timing.Complete(k, chunkTime); };
+				controller.distribution.Begin(chunks.size());
+				controller.wake.Start(workerPtrs);
+				size_t k = 0;
+				for (const auto& chunk : chunks)
+				{
+					alloc::Scope chunkScope{ "chunk" };
+					controller.distribution.Publish(k++, MakeView(chunk), done);
+				}
+				controller.distribution.Drain(done);
+				controller.wake.WaitForAll();
+
+				for (const auto& w : workerPtrs)
+				{
+					claims += w->GetNumClaims();
+				}
+			}
+			else
+			{
+				for (const auto& chunk : chunks)
+				{
+					alloc::Scope chunkScope{ "chunk" };
+					timing.BeginChunk();
+
+					controller.distribution.SetChunk(MakeView(chunk));
+					controller.wake.Start(workerPtrs);
+					controller.wake.WaitForAll();
+
+					for (const auto& w : workerPtrs)
+					{
+						claims += w->GetNumClaims();
+					}
+					if constexpr (requires { controller.distribution.EndChunk(); })
+					{
+						controller.distribution.EndChunk();
+					}
+					timing.EndChunk(workerPtrs);
+				}
+			}
+
+			auto t = totalTime.Peek();
+			std::cout << "Processing took " << t << " seconds\n";
+			mem::Report(std::cout, tlbMisses);
+			if constexpr (requires { controller.distribution.Report(std::cout, chunks.size(), claims); })
+			{
+				controller.distribution.Report(std::cout, chunks.size(), claims);
+			}
+
+			const auto& run = controller.workload;
+			auto result = run.Identity();
+			for (const auto& w : workerPtrs)
+			{
+				result = run.Reduce(result, w->GetResult());
+			}
+			work::Report<W>(std::cout, result);
+			const bool withinBound = work::Verify(run, chunks, result, std::cout);
+
+			timing.Write();
+			return withinBound ? 0 : 1;
+		}
+	};
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "Constants.h"
+#include "CpuBudget.h"
+
+namespace tk
+{
+	//Spin-wait hint to the core, a yield where there is none
+	inline void Pause()
+	{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	//Polls before sleeping: DispatchSpin, none when the process has a single CPU and the spinning
+	//would only hold off the thread it waits for
+	inline size_t SpinCount()
+	{
+		static const size_t spin = DetectCpuBudget().Workers() > 1 ? DispatchSpin : 0;
+		return spin;
+	}
+
+	//Waits until value moves off old and returns the new value: SpinCount polls, then sleeps in atomic::wait
+	template<typename T>
+	T AwaitChange(const std::atomic<T>& value, T old)
+	{
+		for (size_t i = 0, spin = SpinCount(); i < spin; i++)
+		{
+			if (const auto now = value.load(std::memory_order_acquire); now != old)
+			{
+				return now;
+			}
+			Pause();
+		}
+		T now;
+		while ((now = value.load(std::memory_order_acquire)) == old)
+		{
+			value.wait(old, std::memory_order_acquire);
+		}
+		return now;
+	}
+
+	//Starts a round on every worker with one store and one notify_all, and counts them back in with an atomic
+	//latch the main thread waits on. Replaces a lock / notify per worker to start and a locked done count to finish
+	class Epoch
+	{
+	public:
+		//Main thread: whatever was written before this is visible to the workers in the round
+		void Broadcast(size_t workers)
+		{
+			pending.store(workers, std::memory_order_relaxed);
+			epoch.fetch_add(1, std::memory_order_release);
+			epoch.notify_all();
+		}
+
+		//Main thread: returns once every worker of the round has arrived, their writes visible
+		void WaitForAll()
+		{
+			for (auto left = pending.load(std::memory_order_acquire); left != 0; left = AwaitChange(pending, left));
+		}
+
+		//Worker: waits for the round after seen. False once terminated
+		bool Await(uint64_t& seen)
+		{
+			seen = AwaitChange(epoch, seen);
+			return !terminated.load(std::memory_order_acquire);
+		}
+
+		//Worker: done with the round
+		void Arrive()
+		{
+			if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				pending.notify_one();
+			}
+		}
+
+		void Terminate()
+		{
+			terminated.store(true, std::memory_order_release);
+			epoch.fetch_add(1, std::memory_order_release);
+			epoch.notify_all();
+		}
+
+	private:
+		alignas(std::hardware_destructive_interference_size) std::atomic<uint64_t> epoch = 0; //Read by every worker
+		std::atomic<bool> terminated = false;
+		alignas(std::hardware_destructive_interference_size) std::atomic<size_t> pending = 0; //Written by every worker
+	};
+
+	//Round trip of an empty round, starting every worker and waiting for all of them, per-worker mutex / cv
+	//handshakes (as with epochDispatchEnabled off) against an Epoch. Plain threads so every worker count runs
+	inline void BenchmarkDispatch(std::ostream& out, std::vector<size_t> workerCounts = { 1, 2, 4, 8 }, size_t rounds = 10'000)
+	{
+		struct alignas(std::hardware_destructive_interference_size) Handshake
+		{
+			std::mutex mtx;
+			std::condition_variable cv;
+			bool working = false;
+			bool terminate = false;
+		};
+
+		const auto handshakes = [rounds](size_t workers)
+		{
+			std::mutex doneMtx;
+			std::condition_variable doneCv;
+			size_t doneCount = 0;
+			const auto slots = std::make_unique<Handshake[]>(workers);
+			std::vector<std::jthread> threads;
+			for (size_t w = 0; w < workers; w++)
+			{
+				threads.emplace_back([&, w]
+				{
+					auto& slot = slots[w];
+					std::unique_lock lk{ slot.mtx };
+					while (true)
+					{
+						slot.cv.wait(lk, [&] {return slot.working || slot.terminate; });
+						if (slot.terminate)
+						{
+							break;
+						}
+						slot.working = false;
+						{
+							std::lock_guard doneLk{ doneMtx };
+							++doneCount;
+						}
+						doneCv.notify_one();
+					}
+				});
+			}
+
+			const auto begin = std::chrono::steady_clock::now();
+			for (size_t r = 0; r < rounds; r++)
+			{
+				for (size_t w = 0; w < workers; w++)
+				{
+					{
+						std::lock_guard lk{ slots[w].mtx };
+						slots[w].working = true;
+					}
+					slots[w].cv.notify_one();
+				}
+				std::unique_lock lk{ doneMtx };
+				doneCv.wait(lk, [&] {return doneCount == workers; });
+				doneCount = 0;
+			}
+			const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / double(rounds);
+
+			for (size_t w = 0; w < workers; w++)
+			{
+				{
+					std::lock_guard lk{ slots[w].mtx };
+					slots[w].terminate = true;
+				}
+				slots[w].cv.notify_one();
+			}
+			return ns;
+		};
+
+		const auto epoch = [rounds](size_t workers)
+		{
+			Epoch dispatch;
+			std::vector<std::jthread> threads;
+			for (size_t w = 0; w < workers; w++)
+			{
+				threads.emplace_back([&]
+				{
+					for (uint64_t seen = 0; dispatch.Await(seen); )
+					{
+						dispatch.Arrive();
+					}
+				});
+			}
+
+			const auto begin = std::chrono::steady_clock::now();
+			for (size_t r = 0; r < rounds; r++)
+			{
+				dispatch.Broadcast(workers);
+				dispatch.WaitForAll();
+			}
+			const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / double(rounds);
+			dispatch.Terminate();
+			return ns;
+		};
+
+		out << "workers, handshake us/round, epoch us/round\n";
+		for (const auto workers : workerCounts)
+		{
+			out << std::format("{}, {:.2f}, {:.2f}\n", workers, handshakes(workers) / 1000., epoch(workers) / 1000.);
+		}
+	}
+}
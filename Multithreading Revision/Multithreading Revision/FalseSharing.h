@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "HugePages.h"
+
+namespace tk
+{
+	namespace detail
+	{
+		struct alignas(std::hardware_destructive_interference_size) PaddedCounter
+		{
+			std::atomic<size_t> value = 0;
+		};
+
+		//Every worker writing its own slot writes times. Returns ns per write and L1D load misses taken
+		template<typename Slot>
+		std::pair<double, std::optional<uint64_t>> MeasureWrites(size_t workers, size_t writes)
+		{
+			std::vector<Slot> slots(workers);
+			std::atomic<size_t> ready = 0;
+			mem::EventCounter misses{ mem::EventCounter::Event::L1dLoadMisses };
+			const auto before = misses.Read();
+			const auto begin = std::chrono::steady_clock::now();
+			{
+				std::vector<std::jthread> threads;
+				for (size_t w = 0; w < workers; w++)
+				{
+					threads.emplace_back([&, w]
+					{
+						++ready;
+						while (ready.load() < workers)
+						{
+							std::this_thread::yield();
+						}
+						auto& slot = slots[w];
+						for (size_t i = 0; i < writes; i++)
+						{
+							//Load and store rather than an RMW, the way workers update their results
+							if constexpr (requires { slot.value; })
+							{
+								slot.value.store(slot.value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+							}
+							else
+							{
+								slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+							}
+						}
+					});
+				}
+			}
+			const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / double(workers * writes);
+			const auto after = misses.Read();
+			return { ns, after && before ? std::optional{ *after - *before } : std::nullopt };
+		}
+	}
+
+	//Per-worker slots written in a tight loop, packed next to each other against one per cache line: the
+	//cost of false sharing the crews' worker and controller layouts avoid. Plain threads so every worker
+	//count runs, the miss counts need perf events (n/a otherwise)
+	inline void BenchmarkFalseSharing(std::ostream& out, std::vector<size_t> workerCounts = { 2, 4, 8, 16 }, size_t writes = size_t(1) << 24)
+	{
+		const auto misses = [](const std::optional<uint64_t>& count)
+		{
+			return count ? std::to_string(*count) : std::string{ "n/a" };
+		};
+
+		out << "workers, packed ns/write, padded ns/write, packed L1D load misses, padded L1D load misses\n";
+		for (const auto workers : workerCounts)
+		{
+			const auto [packedNs, packedMisses] = detail::MeasureWrites<std::atomic<size_t>>(workers, writes);
+			const auto [paddedNs, paddedMisses] = detail::MeasureWrites<detail::PaddedCounter>(workers, writes);
+			out << std::format("{}, {:.2f}, {:.2f}, {}, {}\n", workers, packedNs, paddedNs, misses(packedMisses), misses(paddedMisses));
+		}
+	}
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <random>
+#include <ranges>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+#include "Workload.h"
+#include "HugePages.h"
+
+//Load shapes beyond the random / even / stacked streams in CounterRng.h, for stress testing the strategies.
+//The heavy/light shapes fill Task chunks of any size. Continuous costs need a per-task trip count, so
+//those fill CostedTask chunks run through CostedWorkload.
+namespace gen
+{
+	using Seed = std::minstd_rand::result_type;
+
+	namespace detail
+	{
+		template<typename Chunk>
+		void FillBernoulli(Chunk& chunk, std::minstd_rand& rne, double probabilityHeavy)
+		{
+			std::bernoulli_distribution hDist{ std::clamp(probabilityHeavy, 0., 1.) };
+			std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
+			std::ranges::generate(chunk, [&] {return Task{ .val = rDist(rne), .heavy = hDist(rne) }; });
+		}
+
+		//Random values, heavyCount tasks from begin on heavy (wrapping around the end)
+		template<typename Chunk>
+		void FillPlaced(Chunk& chunk, std::minstd_rand& rne, size_t begin, size_t heavyCount)
+		{
+			std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
+			const auto size = std::ranges::size(chunk);
+			for (auto& task : chunk)
+			{
+				task = Task{ .val = rDist(rne), .heavy = false };
+			}
+			for (size_t i = 0; i < std::min(heavyCount, size); i++)
+			{
+				chunk[(begin + i) % size].heavy = true;
+			}
+		}
+
+		template<typename Chunk>
+		size_t HeavyTarget(const Chunk& chunk, double probabilityHeavy)
+		{
+			return size_t(std::lround(double(std::ranges::size(chunk)) * probabilityHeavy));
+		}
+	}
+
+	//A burstFraction of the chunks carries heavies at probabilityInBurst, the rest at whatever keeps the
+	//overall fraction at probabilityHeavy (0 when the bursts already exceed it)
+	template<typename Data>
+	void FillBursty(Data& chunks, double burstFraction = .1, double probabilityInBurst = .4, double probabilityHeavy = ProbabilityHeavy, Seed seed = std::minstd_rand::default_seed)
+	{
+		std::minstd_rand rne{ seed };
+		std::bernoulli_distribution burstDist{ burstFraction };
+		const auto probabilityOutside = burstFraction < 1. ? std::max((probabilityHeavy - burstFraction * probabilityInBurst) / (1. - burstFraction), 0.) : 0.;
+		for (auto& chunk : chunks)
+		{
+			detail::FillBernoulli(chunk, rne, burstDist(rne) ? probabilityInBurst : probabilityOutside);
+		}
+	}
+
+	//Heavy probability moving linearly from the first chunk to the last
+	template<typename Data>
+	void FillDrifting(Data& chunks, double probabilityFrom = 0., double probabilityTo = 2. * ProbabilityHeavy, Seed seed = std::minstd_rand::default_seed)
+	{
+		std::minstd_rand rne{ seed };
+		const auto count = std::ranges::size(chunks);
+		size_t c = 0;
+		for (auto& chunk : chunks)
+		{
+			const auto t = count > 1 ? double(c++) / double(count - 1) : 0.;
+			detail::FillBernoulli(chunk, rne, probabilityFrom + (probabilityTo - probabilityFrom) * t);
+		}
+	}
+
+	//Heavies in runs averaging meanRun tasks (two-state Markov chain), still probabilityHeavy overall
+	template<typename Data>
+	void FillClustered(Data& chunks, double meanRun = 50., double probabilityHeavy = ProbabilityHeavy, Seed seed = std::minstd_rand::default_seed)
+	{
+		std::minstd_rand rne{ seed };
+		std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
+		const auto leave = 1. / std::max(meanRun, 1.);
+		const auto enter = probabilityHeavy < 1. ? std::min(probabilityHeavy * leave / (1. - probabilityHeavy), 1.) : 1.;
+		std::bernoulli_distribution enterDist{ enter }, leaveDist{ leave };
+		bool heavy = false;
+		for (auto& chunk : chunks)
+		{
+			std::ranges::generate(chunk, [&] {
+				heavy = heavy ? !leaveDist(rne) : enterDist(rne);
+				return Task{ .val = rDist(rne), .heavy = heavy };
+				});
+		}
+	}
+
+	//Every heavy of a chunk packed against the end of one of the subsets pre::Experiment splits it into for
+	//workerCount workers (same boundaries), a different subset each chunk: per-worker totals even out over a
+	//run, yet within every chunk one worker gets all the expensive tasks while the rest idle
+	template<typename Data>
+	void FillAdversarialPreassigned(Data& chunks, size_t workerCount, double probabilityHeavy = ProbabilityHeavy, Seed seed = std::minstd_rand::default_seed)
+	{
+		std::minstd_rand rne{ seed };
+		workerCount = std::max<size_t>(workerCount, 1);
+		size_t c = 0;
+		for (auto& chunk : chunks)
+		{
+			const auto size = std::ranges::size(chunk);
+			const auto heavyCount = std::min(detail::HeavyTarget(chunk, probabilityHeavy), size);
+			const auto subset = c++ % workerCount;
+			const auto end = (subset + 1) * size / workerCount;
+			detail::FillPlaced(chunk, rne, (end + size - heavyCount) % size, heavyCount);
+		}
+	}
+
+	//Heavies at the end of each chunk: dynamic strategies hand them out last, so the chunk finishes on
+	//whichever workers drew them while the others idle
+	template<typename Data>
+	void FillAdversarialTail(Data& chunks, double probabilityHeavy = ProbabilityHeavy, Seed seed = std::minstd_rand::default_seed)
+	{
+		std::minstd_rand rne{ seed };
+		for (auto& chunk : chunks)
+		{
+			const auto heavyCount = detail::HeavyTarget(chunk, probabilityHeavy);
+			detail::FillPlaced(chunk, rne, std::ranges::size(chunk) - std::min(heavyCount, std::ranges::size(chunk)), heavyCount);
+		}
+	}
+
+	//A task with its own trip count
+	struct CostedTask
+	{
+		double val;
+		uint32_t iterations;
+	};
+
+	//Costs are relative to a light task; everything above one counts as heavy for the strategies' statistics
+	struct CostedWorkload
+	{
+		using Item = CostedTask;
+		using Result = unsigned int;
+
+		static Result Process(const CostedTask& task)
+		{
+			return Task{ .val = task.val, .heavy = false }.Process(size_t(task.iterations));
+		}
+		static size_t Cost(const CostedTask& task)
+		{
+			return std::max<size_t>(task.iterations / LightIterations, 1);
+		}
+		static Result Reduce(Result a, Result b)
+		{
+			return a + b;
+		}
+		static Result Identity()
+		{
+			return 0;
+		}
+	};
+	static_assert(Workload<CostedWorkload>);
+
+	using CostedChunk = mem::Vector<CostedTask>;
+	using CostedDataset = mem::Vector<CostedChunk>;
+
+	inline CostedDataset MakeCostedDataset(size_t chunkCount = ChunkCount, size_t chunkSize = ChunkSize)
+	{
+		return CostedDataset(chunkCount, CostedChunk(chunkSize));
+	}
+
+	//Trip counts LightIterations * k with P(k) ~ 1 / k^exponent, k in [1, maxMultiple]
+	template<typename Data>
+	void FillZipf(Data& chunks, double exponent = 1.1, size_t maxMultiple = HeavyIterations / LightIterations, Seed seed = std::minstd_rand::default_seed)
+	{
+		std::minstd_rand rne{ seed };
+		std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
+		const auto weights = std::views::iota(size_t(1), maxMultiple + 1) |
+			std::views::transform([&](size_t k) {return 1. / std::pow(double(k), exponent); }) |
+			std::ranges::to<std::vector>();
+		std::discrete_distribution<size_t> kDist{ weights.begin(), weights.end() };
+		for (auto& chunk : chunks)
+		{
+			std::ranges::generate(chunk, [&] {return CostedTask{ .val = rDist(rne), .iterations = uint32_t(LightIterations * (kDist(rne) + 1)) }; });
+		}
+	}
+
+	//Log-normal trip counts around medianIterations, capped at maxIterations
+	template<typename Data>
+	void FillLogNormal(Data& chunks, double medianIterations = double(LightIterations), double sigma = 1., size_t maxIterations = 10 * HeavyIterations, Seed seed = std::minstd_rand::default_seed)
+	{
+		std::minstd_rand rne{ seed };
+		std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
+		std::lognormal_distribution iDist{ std::log(medianIterations), sigma };
+		for (auto& chunk : chunks)
+		{
+			std::ranges::generate(chunk, [&] {
+				const auto iterations = std::clamp(std::llround(iDist(rne)), 1ll, (long long)(maxIterations));
+				return CostedTask{ .val = rDist(rne), .iterations = uint32_t(iterations) };
+				});
+		}
+	}
+}
@@ -0,0 +1,340 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+//Allocation for datasets and other big buffers. Allocations of a huge page or more are mapped 2 MB aligned
+//and backed by huge pages where the system allows (explicit hugetlb pages, or transparent huge pages),
+//falling back to normal pages otherwise; smaller ones are plain cache-line aligned allocations.
+namespace mem
+{
+	enum class HugePages
+	{
+		Off, //4 KB pages, transparent huge pages disabled for the mapping
+		Transparent, //madvise(MADV_HUGEPAGE), the kernel backs what it can
+		Explicit, //MAP_HUGETLB / MEM_LARGE_PAGES from the reserved pool, Transparent if that fails
+	};
+
+	constexpr size_t HugePageSize = size_t(2) << 20;
+	constexpr size_t CacheLine = 64;
+
+	namespace detail
+	{
+		inline std::atomic<HugePages> mode = HugePages::Transparent;
+		inline std::mutex explicitMtx;
+		inline std::unordered_map<void*, size_t> explicitMappings; //From the hugetlb / large page pool, address -> bytes
+		inline size_t explicitBytes = 0;
+
+		inline void AddExplicit(void* p, size_t bytes)
+		{
+			std::lock_guard lk{ explicitMtx };
+			explicitMappings.emplace(p, bytes);
+			explicitBytes += bytes;
+		}
+
+		inline void RemoveExplicit(void* p)
+		{
+			std::lock_guard lk{ explicitMtx };
+			if (const auto it = explicitMappings.find(p); it != explicitMappings.end())
+			{
+				explicitBytes -= it->second;
+				explicitMappings.erase(it);
+			}
+		}
+
+		inline size_t ExplicitBytes()
+		{
+			std::lock_guard lk{ explicitMtx };
+			return explicitBytes;
+		}
+
+		constexpr size_t RoundUp(size_t bytes, size_t to)
+		{
+			return (bytes + to - 1) / to * to;
+		}
+
+		inline void* Map(size_t bytes)
+		{
+#ifdef _WIN32
+			if (mode == HugePages::Explicit)
+			{
+				//Needs SeLockMemoryPrivilege, without it this fails and normal pages are used
+				if (const auto large = GetLargePageMinimum())
+				{
+					const auto rounded = RoundUp(bytes, large);
+					if (auto* p = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+					{
+						AddExplicit(p, rounded);
+						return p;
+					}
+				}
+			}
+			auto* p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (!p)
+			{
+				throw std::bad_alloc{};
+			}
+			return p;
+#else
+			const auto rounded = RoundUp(bytes, HugePageSize);
+#ifdef MAP_HUGETLB
+			if (mode == HugePages::Explicit)
+			{
+				auto* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (p != MAP_FAILED)
+				{
+					AddExplicit(p, rounded);
+					return p;
+				}
+			}
+#endif
+			//Over-map by a huge page and trim, so the range starts on a huge page boundary
+			auto* raw = static_cast<std::byte*>(mmap(nullptr, rounded + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+			if (raw == MAP_FAILED)
+			{
+				throw std::bad_alloc{};
+			}
+			auto* aligned = raw + (HugePageSize - reinterpret_cast<uintptr_t>(raw) % HugePageSize) % HugePageSize;
+			if (aligned != raw)
+			{
+				munmap(raw, size_t(aligned - raw));
+			}
+			if (const auto tail = size_t(raw + rounded + HugePageSize - (aligned + rounded)))
+			{
+				munmap(aligned + rounded, tail);
+			}
+#ifdef MADV_HUGEPAGE
+			madvise(aligned, rounded, mode == HugePages::Off ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+#endif
+			return aligned;
+#endif
+		}
+
+		inline void Unmap(void* p, size_t bytes)
+		{
+			RemoveExplicit(p);
+#ifdef _WIN32
+			VirtualFree(p, 0, MEM_RELEASE);
+#else
+			munmap(p, RoundUp(bytes, HugePageSize));
+#endif
+		}
+
+#ifdef __linux__
+		inline int OpenCounter(uint32_t type, uint64_t config, bool inherit)
+		{
+			perf_event_attr attr{};
+			attr.size = sizeof(attr);
+			attr.type = type;
+			attr.config = config;
+			attr.inherit = inherit; //Threads started afterwards count too, once they exit
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+		}
+
+		constexpr uint64_t CacheReadMisses(uint64_t cache)
+		{
+			return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		}
+#endif
+
+		//Anonymous memory actually backed by transparent huge pages
+		inline std::optional<size_t> AnonHugeBytes()
+		{
+			std::ifstream smaps{ "/proc/self/smaps_rollup" };
+			for (std::string line; std::getline(smaps, line); )
+			{
+				if (line.starts_with("AnonHugePages:"))
+				{
+					size_t kb = 0;
+					std::istringstream{ line.substr(14) } >> kb;
+					return kb * 1024;
+				}
+			}
+			return {};
+		}
+	}
+
+	inline void SetHugePageMode(HugePages hugePages)
+	{
+		detail::mode = hugePages;
+	}
+
+	inline HugePages GetHugePageMode()
+	{
+		return detail::mode;
+	}
+
+	//Huge page backed for big allocations, cache-line aligned for all
+	template<typename T>
+	class HugePageAllocator
+	{
+	public:
+		using value_type = T;
+
+		static constexpr size_t Alignment = alignof(T) > CacheLine ? alignof(T) : CacheLine;
+
+		HugePageAllocator() = default;
+		template<typename U>
+		HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+		T* allocate(size_t n)
+		{
+			const auto bytes = n * sizeof(T);
+			if (bytes >= HugePageSize)
+			{
+				return static_cast<T*>(detail::Map(bytes));
+			}
+			return static_cast<T*>(::operator new(bytes, std::align_val_t{ Alignment }));
+		}
+
+		void deallocate(T* p, size_t n) noexcept
+		{
+			const auto bytes = n * sizeof(T);
+			if (bytes >= HugePageSize)
+			{
+				detail::Unmap(p, bytes);
+			}
+			else
+			{
+				::operator delete(p, std::align_val_t{ Alignment });
+			}
+		}
+
+		template<typename U>
+		bool operator == (const HugePageAllocator<U>&) const
+		{
+			return true;
+		}
+	};
+
+	template<typename T>
+	using Vector = std::vector<T, HugePageAllocator<T>>;
+
+	//A hardware event counted in the calling thread and, inherited, the threads it starts afterwards: their counts
+	//are only added in as they exit. Reads are empty where perf events aren't available
+	class EventCounter
+	{
+	public:
+		enum class Event
+		{
+			DtlbLoadMisses,
+			L1dLoadMisses,
+		};
+
+		explicit EventCounter(Event event, bool inherited = true)
+		{
+#ifdef __linux__
+			fd = detail::OpenCounter(PERF_TYPE_HW_CACHE, detail::CacheReadMisses(event == Event::DtlbLoadMisses ? PERF_COUNT_HW_CACHE_DTLB : PERF_COUNT_HW_CACHE_L1D), inherited);
+#endif
+		}
+		EventCounter(const EventCounter&) = delete;
+		EventCounter& operator = (const EventCounter&) = delete;
+
+		std::optional<uint64_t> Read() const
+		{
+#ifdef __linux__
+			uint64_t count = 0;
+			if (fd >= 0 && read(fd, &count, sizeof(count)) == sizeof(count))
+			{
+				return count;
+			}
+#endif
+			return {};
+		}
+
+		~EventCounter()
+		{
+#ifdef __linux__
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+#endif
+		}
+
+	private:
+		int fd = -1;
+	};
+
+	namespace detail
+	{
+		//One dTLB counter per counted thread, each counting only its own thread
+		struct TlbCounters
+		{
+			std::mutex mtx;
+			std::vector<std::unique_ptr<EventCounter>> counters;
+		};
+
+		inline TlbCounters& GetTlbCounters()
+		{
+			static TlbCounters tlbCounters;
+			return tlbCounters;
+		}
+	}
+
+	//Counts the calling thread's dTLB load misses into TlbMisses from now on. The runtime's workers call it as
+	//they start, persistent threads never exit to hand an inherited count back
+	inline void CountTlbMisses()
+	{
+		auto counter = std::make_unique<EventCounter>(EventCounter::Event::DtlbLoadMisses, false);
+		auto& tlbCounters = detail::GetTlbCounters();
+		std::lock_guard lk{ tlbCounters.mtx };
+		tlbCounters.counters.push_back(std::move(counter));
+	}
+
+	//dTLB load misses so far, summed over the thread that first calls this and every thread that called
+	//CountTlbMisses
+	inline std::optional<uint64_t> TlbMisses()
+	{
+		[[maybe_unused]] static const bool counted = (CountTlbMisses(), true);
+		auto& tlbCounters = detail::GetTlbCounters();
+		std::lock_guard lk{ tlbCounters.mtx };
+		std::optional<uint64_t> total;
+		for (const auto& counter : tlbCounters.counters)
+		{
+			if (const auto count = counter->Read())
+			{
+				total = total.value_or(0) + *count;
+			}
+		}
+		return total;
+	}
+
+	//One line for benchmark output: dTLB misses since before and how much memory sits on huge pages
+	inline void Report(std::ostream& out, std::optional<uint64_t> tlbMissesBefore)
+	{
+		const auto tlbMisses = TlbMisses();
+		const auto anonHuge = detail::AnonHugeBytes();
+		out << std::format("dTLB load misses: {}, huge pages: {} MB transparent, {} MB explicit\n",
+			tlbMisses && tlbMissesBefore ? std::to_string(*tlbMisses - *tlbMissesBefore) : "n/a",
+			anonHuge ? std::to_string(*anonHuge >> 20) : "n/a",
+			detail::ExplicitBytes() >> 20);
+	}
+}
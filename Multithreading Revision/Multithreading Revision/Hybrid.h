@@ -0,0 +1,167 @@
+#pragma once
+#include <format>
+#include <optional>
+#include <ostream>
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "Timer.h"
+#include "Runtime.h"
+#include "Workload.h"
+#include "ShardedRange.h"
+#include "AtomicQueue.h"
+#include "Engine.h"
+
+//Static head, dynamic tail: the first staticFraction of each chunk is split into one contiguous block per
+//worker as in pre, claimed with no shared traffic at all. The rest is handed out through atq's claims to
+//whichever workers finish their block first, which absorbs the imbalance of the blocks.
+namespace hyb
+{
+	//Picks the static fraction of the next chunk from how uneven the static blocks of the previous ones were.
+	//Blocks spread by (max - mean) / mean = r need a tail of about r of the head, so the head gets 1 / (1 + 2r)
+	//of the chunk, the factor 2 being margin. r is smoothed over chunks
+	class FractionTuner
+	{
+	public:
+		FractionTuner(std::optional<double> fixed) : fixed{ fixed }, fraction{ fixed.value_or(HybridStaticFraction) } {}
+
+		double Fraction() const
+		{
+			return fraction;
+		}
+
+		void Observe(const float* blockTimes, size_t workerCount)
+		{
+			if (fixed || workerCount == 0)
+			{
+				return;
+			}
+			const auto [minIt, maxIt] = std::minmax_element(blockTimes, blockTimes + workerCount);
+			double mean = 0.;
+			for (size_t i = 0; i < workerCount; i++)
+			{
+				mean += blockTimes[i];
+			}
+			mean /= double(workerCount);
+			if (mean <= 0.)
+			{
+				return;
+			}
+			spread = .5 * spread + .5 * (double(*maxIt) - mean) / mean;
+			fraction = std::clamp(1. / (1. + 2. * spread), 0., HybridMaxStaticFraction);
+		}
+
+	private:
+		std::optional<double> fixed;
+		double fraction;
+		double spread = 0.;
+	};
+
+
+	template<atq::claim::Policy Claim>
+	struct Distribution
+	{
+		template<typename View, Workload W>
+		class For
+		{
+		public:
+			For(size_t workerCount, std::optional<double> staticFraction)
+				:
+				workerCount{ workerCount },
+				ranges{ workerCount },
+				tuner{ staticFraction },
+				staticTimes(workerCount),
+				blockTimes(workerCount)
+			{}
+
+			void SetChunk(View chunk)
+			{
+				const auto fraction = tuner.Fraction();
+				fractions += fraction;
+				currentChunk = chunk;
+				staticEnd = size_t(std::llround(std::clamp(fraction, 0., 1.) * double(chunk.size())));
+				ranges.Reset(chunk.size() - staticEnd);
+			}
+
+			//Static block first, straight through the bulk kernel as in pre, then the tail
+			template<typename Sink>
+			void Process(size_t worker, Sink& sink)
+			{
+				Timer timer;
+				sink.Block(StaticBlock_(worker));
+				staticTimes[worker].time = timer.Peek();
+
+				size_t group = ranges.HomeGroup(worker);
+				while (const auto range = ClaimRange_(group))
+				{
+					sink.Range(*range);
+				}
+			}
+
+			void EndChunk()
+			{
+				for (size_t i = 0; i < workerCount; i++)
+				{
+					blockTimes[i] = staticTimes[i].time;
+				}
+				tuner.Observe(blockTimes.data(), workerCount);
+			}
+
+			void Report(std::ostream& out, size_t chunkCount, size_t claims) const
+			{
+				const auto count = double(std::max<size_t>(chunkCount, 1));
+				out << std::format("{:.2f} static on average, {:.1f} tail claims per chunk ({})\n", fractions / count, double(claims) / count, Claim::name);
+			}
+
+		private:
+			//Even split of the static head, the remainder spreads over the later blocks
+			View StaticBlock_(size_t worker) const
+			{
+				return currentChunk.Subview(worker * staticEnd / workerCount, (worker + 1) * staticEnd / workerCount);
+			}
+
+			//Next range of the tail, empty once it is used up
+			std::optional<View> ClaimRange_(size_t& group)
+			{
+				const auto range = ranges.template Claim<Claim::fixed>(group, [this](size_t start, size_t total) {return Claim::Size(start, total, ranges.GroupWorkers()); });
+				if (!range)
+				{
+					return {};
+				}
+				return currentChunk.Subview(staticEnd + range->first, staticEnd + range->second);
+			}
+
+			//Written by one worker each, read once the chunk is done
+			struct alignas(std::hardware_destructive_interference_size) StaticTime
+			{
+				float time = 0.f;
+			};
+
+			//Read-mostly
+			View currentChunk;
+			size_t staticEnd = 0; //Tasks [0, staticEnd) are the static blocks
+			size_t workerCount;
+			tk::ShardedRange<> ranges; //The tail, offsets from staticEnd
+
+			//Main thread only, between chunks
+			FractionTuner tuner;
+			std::vector<StaticTime> staticTimes;
+			std::vector<float> blockTimes;
+			double fractions = 0.;
+		};
+	};
+
+	//Runs any Workload, Task data as a Dataset or an SoaDataset. A fixed staticFraction keeps that share of every
+	//chunk static, without one the share adapts chunk by chunk (see FractionTuner)
+	template<Workload W = TaskWorkload<>, atq::claim::Policy Claim = atq::claim::Guided, typename Data>
+	int Experiment(Data chunks, size_t workerCount = tk::DefaultWorkerCount(), std::optional<double> staticFraction = {}, W workload = W{})
+	{
+		return eng::Engine<Distribution<Claim>>::Experiment(std::move(chunks), workerCount, std::move(workload), staticFraction);
+	}
+}
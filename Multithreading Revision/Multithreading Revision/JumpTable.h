@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <ostream>
+#include <format>
+#include <random>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "Runtime.h"
+#include "Timer.h"
+
+//After its first step a task is one of States digit values, so the rest of Task::Process is a walk on a
+//fixed functional graph. The successor of every state is computed once (the only trig left), binary lifting
+//tables give any number of steps in O(log n) lookups, and the two step counts tasks actually use are
+//folded with the final exp into direct tables: a task costs one Step plus one load.
+//Exact: every state runs the same Task::Step the reference loop does.
+namespace jump
+{
+	constexpr size_t States = 100'000;
+
+	using Table = std::vector<uint32_t>;
+
+	struct Tables
+	{
+		std::vector<Table> levels; //levels[j][s] = state 2^j steps after s
+		Table lightResult; //Process() result of a light task whose first step landed on s
+		Table heavyResult;
+
+		uint32_t Advance(uint32_t state, size_t steps) const
+		{
+			const auto top = levels.size() - 1;
+			for (; steps >> top > 1; steps -= size_t(1) << top)
+			{
+				state = levels[top][state];
+			}
+			for (; steps; steps &= steps - 1)
+			{
+				state = levels[std::countr_zero(steps)][state];
+			}
+			return state;
+		}
+	};
+
+	namespace detail
+	{
+		inline unsigned int Result(uint32_t state)
+		{
+			return (unsigned int)(std::exp(double(state) / 10'000.));
+		}
+
+		inline Tables Build()
+		{
+			Tables tables;
+			const auto levelCount = std::max<size_t>(std::bit_width(HeavyIterations - 1), 1);
+			tables.levels.assign(levelCount, Table(States));
+
+			tk::ParallelFor(States, [&](size_t s) {tables.levels[0][s] = Task::Step(double(s) / 10'000.); });
+			for (size_t j = 1; j < levelCount; j++)
+			{
+				const auto& half = tables.levels[j - 1];
+				tk::ParallelFor(States, [&, j](size_t s) {tables.levels[j][s] = half[half[s]]; });
+			}
+
+			tables.lightResult.resize(States);
+			tables.heavyResult.resize(States);
+			tk::ParallelFor(States, [&](size_t s)
+			{
+				tables.lightResult[s] = Result(tables.Advance(uint32_t(s), LightIterations - 1));
+				tables.heavyResult[s] = Result(tables.Advance(uint32_t(s), HeavyIterations - 1));
+			});
+			return tables;
+		}
+	}
+
+	//Built on first use, call it once from the main thread before experiments hand work to the runtime
+	inline const Tables& Get()
+	{
+		static const Tables tables = detail::Build();
+		return tables;
+	}
+
+	inline unsigned int Process(const Task& task)
+	{
+		const auto& tables = Get();
+		const auto state = Task::Step(task.val);
+		return (task.heavy ? tables.heavyResult : tables.lightResult)[state];
+	}
+
+	template<ChunkViewType View>
+	unsigned int Process(const View& tasks)
+	{
+		unsigned int sum = 0;
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			sum += Process(tasks[i]);
+		}
+		return sum;
+	}
+
+	//Equivalence with the reference loop: a generated chunk task by task, and Advance against plain stepping
+	inline bool Validate(std::ostream& out)
+	{
+		Timer timer;
+		timer.Mark();
+		const auto& tables = Get();
+		const auto buildTime = timer.Peek();
+
+		std::minstd_rand rne;
+		std::bernoulli_distribution hDist{ ProbabilityHeavy };
+		std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
+		size_t taskMismatches = 0;
+		for (size_t i = 0; i < ChunkSize; i++)
+		{
+			//Every other task forced heavy so both tables get exercised
+			const Task task{ .val = rDist(rne), .heavy = i % 2 == 0 || hDist(rne) };
+			taskMismatches += Process(task) != task.Process();
+		}
+
+		std::uniform_int_distribution<uint32_t> sDist{ 0, States - 1 };
+		std::uniform_int_distribution<size_t> nDist{ 0, 4 * HeavyIterations };
+		size_t advanceMismatches = 0;
+		for (int i = 0; i < 1'000; i++)
+		{
+			const auto start = sDist(rne);
+			const auto steps = nDist(rne);
+			auto state = start;
+			for (size_t n = 0; n < steps; n++)
+			{
+				state = tables.levels[0][state];
+			}
+			advanceMismatches += tables.Advance(start, steps) != state;
+		}
+
+		out << std::format("Jump tables: {} levels built in {}s, {} task and {} advance mismatches\n",
+			tables.levels.size(), buildTime, taskMismatches, advanceMismatches);
+		return taskMismatches == 0 && advanceMismatches == 0;
+	}
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <format>
+#include <ostream>
+#include <type_traits>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "MathPolicy.h"
+#include "SimdKernel.h"
+#include "JumpTable.h"
+
+//Task processing for a given math policy, routed to the fastest engine that computes exactly that policy:
+//jump tables for libm, the vector kernel for the polynomial, otherwise fixed-trip-count kernels per heavy/light run
+namespace kernel
+{
+	template<math::Policy Math>
+	constexpr bool tabulated = jumpTableEnabled && std::is_same_v<Math, math::Libm>;
+	template<math::Policy Math>
+	constexpr bool vectorized = simdKernelEnabled && std::is_same_v<Math, math::FastPoly>;
+
+	namespace detail
+	{
+		constexpr size_t Lanes = 4;
+
+		//Lanes independent chains of Task::Process<Iterations, Math> interleaved so their latencies overlap,
+		//only the first count lanes are summed (the rest is padding)
+		template<size_t Iterations, math::Policy Math>
+		unsigned int ProcessLanes(std::array<typename Math::Real, Lanes> x, size_t count = Lanes)
+		{
+			using Real = typename Math::Real;
+			for (size_t it = 0; it < Iterations; it++)
+			{
+				for (auto& v : x)
+				{
+					v = Real(Task::Step<Math>(v)) / Real(10'000.);
+				}
+			}
+			unsigned int sum = 0;
+			for (size_t l = 0; l < count; l++)
+			{
+				sum += (unsigned int)(Math::Exp(x[l]));
+			}
+			return sum;
+		}
+
+		//Tasks of one trip count collected until all lanes are full
+		template<size_t Iterations, math::Policy Math>
+		class LaneBuffer
+		{
+		public:
+			unsigned int Push(double val)
+			{
+				pending[count++] = typename Math::Real(val);
+				return count == Lanes ? Flush() : 0;
+			}
+			unsigned int Flush()
+			{
+				const auto sum = count ? ProcessLanes<Iterations, Math>(pending, count) : 0;
+				count = 0;
+				return sum;
+			}
+		private:
+			std::array<typename Math::Real, Lanes> pending{};
+			size_t count = 0;
+		};
+	}
+
+	//Builds what Process and Verify need up front, call it before a crew occupies the runtime
+	template<math::Policy Math>
+	void Prepare()
+	{
+		if constexpr (tabulated<Math> || !Math::exact)
+		{
+			jump::Get();
+		}
+	}
+
+	template<math::Policy Math>
+	unsigned int Process(const Task& task)
+	{
+		if constexpr (tabulated<Math>)
+		{
+			return jump::Process(task);
+		}
+		else
+		{
+			return task.Process<Math>();
+		}
+	}
+
+	template<math::Policy Math, ChunkViewType View>
+	unsigned int Process(const View& tasks)
+	{
+		if constexpr (tabulated<Math>)
+		{
+			return jump::Process(tasks);
+		}
+		else if constexpr (vectorized<Math>)
+		{
+			return simd::Process(tasks);
+		}
+		else
+		{
+			//One weight check per run, each run feeds the lanes of its compile-time trip count
+			unsigned int sum = 0;
+			detail::LaneBuffer<LightIterations, Math> light;
+			detail::LaneBuffer<HeavyIterations, Math> heavy;
+			const auto feed = [&](auto& lanes, size_t begin, size_t end)
+			{
+				for (auto i = begin; i < end; i++)
+				{
+					sum += lanes.Push(tasks[i].val);
+				}
+			};
+			tasks.ForEachRun([&](size_t begin, size_t end, bool isHeavy)
+			{
+				if (isHeavy)
+				{
+					feed(heavy, begin, end);
+				}
+				else
+				{
+					feed(light, begin, end);
+				}
+			});
+			return sum + light.Flush() + heavy.Flush();
+		}
+	}
+
+	//For strategies that get tasks one at a time: vector batches, or light and heavy tasks split into
+	//their own lane buffers. Table lookups need no batching.
+	template<math::Policy Math>
+	class Batch
+	{
+	public:
+		//Sum of whatever got processed by this push
+		unsigned int Push(const Task& task)
+		{
+			if constexpr (vectorized<Math>)
+			{
+				return batch.Push(task);
+			}
+			else if constexpr (tabulated<Math>)
+			{
+				return Process<Math>(task);
+			}
+			else
+			{
+				return task.heavy ? heavy.Push(task.val) : light.Push(task.val);
+			}
+		}
+		unsigned int Flush()
+		{
+			if constexpr (vectorized<Math>)
+			{
+				return batch.Flush();
+			}
+			else
+			{
+				return light.Flush() + heavy.Flush();
+			}
+		}
+	private:
+		simd::Batch batch;
+		detail::LaneBuffer<LightIterations, Math> light;
+		detail::LaneBuffer<HeavyIterations, Math> heavy;
+	};
+
+	//Exact (libm) result over a dataset, cheap through the jump tables
+	template<typename Data>
+	unsigned int ReferenceSum(const Data& chunks)
+	{
+		unsigned int sum = 0;
+		for (const auto& chunk : chunks)
+		{
+			sum += jump::Process(MakeView(chunk));
+		}
+		return sum;
+	}
+
+	//Checks an inexact policy's aggregate against the reference, exact policies pass as is
+	template<math::Policy Math>
+	bool Verify(unsigned int result, unsigned int reference, std::ostream& out, double bound = MathErrorBound)
+	{
+		if constexpr (Math::exact)
+		{
+			return true;
+		}
+		//A reference of 0 (no tasks) leaves nothing to be relative to, the error is then absolute
+		const auto error = std::abs(double(result) - double(reference)) / (reference ? double(reference) : 1.);
+		const bool ok = error <= bound;
+		out << std::format("Math policy {}: reference {}, relative error {:.3} ({} bound {})\n",
+			Math::name, reference, error, ok ? "within" : "OUTSIDE", bound);
+		return ok;
+	}
+
+	template<math::Policy Math, typename Data>
+	bool Verify(const Data& chunks, unsigned int result, std::ostream& out, double bound = MathErrorBound)
+	{
+		if constexpr (Math::exact)
+		{
+			return true;
+		}
+		return Verify<Math>(result, ReferenceSum(chunks), out, bound);
+	}
+}
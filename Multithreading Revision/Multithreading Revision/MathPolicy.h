@@ -0,0 +1,110 @@
+#pragma once
+#include <cmath>
+#include <concepts>
+#include <type_traits>
+
+#include "Constants.h"
+
+//Precision and math library the Task kernel is instantiated with, see Task::Process<Math>.
+//Libm is the reference. The others trade accuracy for throughput: the iteration is chaotic, so single tasks
+//diverge completely and only the aggregate over a dataset stays close (checked against MathErrorBound).
+namespace math
+{
+	namespace poly
+	{
+		//sin(r) = r + r*z*P(z), cos(r) = 1 - z/2 + z*z*Q(z), z = r*r, |r| <= pi/4
+		constexpr double S0 = 1.58962301576546568060E-10, S1 = -2.50507477628578072866E-8, S2 = 2.75573136213857245213E-6,
+			S3 = -1.98412698295895385996E-4, S4 = 8.33333333332211858878E-3, S5 = -1.66666666666666307295E-1;
+		constexpr double C0 = -1.13585365213876817300E-11, C1 = 2.08757008419747316778E-9, C2 = -2.75573141792967388112E-7,
+			C3 = 2.48015872888517045348E-5, C4 = -1.38888888888730564116E-3, C5 = 4.16666666666665929218E-2;
+		//pi/2 split in three so q*PiO2_1 is exact (Cody-Waite)
+		constexpr double TwoOverPi = 0.63661977236758134308;
+		constexpr double PiO2_1 = 1.57079625129699707031, PiO2_2 = 7.54978941586159635336E-8, PiO2_3 = 5.39030285815811905290E-15;
+
+		//Scalar mirror of the vector kernels in SimdKernel.h, op for op
+		inline double SinCosApprox(double x, bool cosine)
+		{
+			const auto q = std::nearbyint(x * TwoOverPi);
+			const auto r = ((x - q * PiO2_1) - q * PiO2_2) - q * PiO2_3;
+			const auto z = r * r;
+			const auto sinr = r + r * z * (((((S0 * z + S1) * z + S2) * z + S3) * z + S4) * z + S5);
+			const auto cosr = (1. - 0.5 * z) + z * z * (((((C0 * z + C1) * z + C2) * z + C3) * z + C4) * z + C5);
+			const bool odd = q - 2. * std::floor(q * 0.5) == 1.;
+			const bool high = q - 4. * std::floor(q * 0.25) >= 2.;
+			auto v = (odd != cosine) ? cosr : sinr;
+			return (cosine ? (odd != high) : high) ? -v : v;
+		}
+	}
+
+	template<typename M>
+	concept Policy = std::floating_point<typename M::Real> && requires(typename M::Real x)
+	{
+		{ M::Sin(x) } -> std::same_as<typename M::Real>;
+		{ M::Cos(x) } -> std::same_as<typename M::Real>;
+		{ M::Exp(x) } -> std::same_as<typename M::Real>;
+		{ M::name } -> std::convertible_to<const char*>;
+		{ M::exact } -> std::convertible_to<bool>;
+	};
+
+	struct Libm
+	{
+		using Real = double;
+		static constexpr const char* name = "libm";
+		static constexpr bool exact = true;
+		static Real Sin(Real x)
+		{
+			return std::sin(x);
+		}
+		static Real Cos(Real x)
+		{
+			return std::cos(x);
+		}
+		static Real Exp(Real x)
+		{
+			return std::exp(x);
+		}
+	};
+
+	//Polynomial sin/cos in double, the scalar form of the SIMD kernel
+	struct FastPoly
+	{
+		using Real = double;
+		static constexpr const char* name = "poly";
+		static constexpr bool exact = false;
+		static Real Sin(Real x)
+		{
+			return poly::SinCosApprox(x, false);
+		}
+		static Real Cos(Real x)
+		{
+			return poly::SinCosApprox(x, true);
+		}
+		static Real Exp(Real x)
+		{
+			return std::exp(x);
+		}
+	};
+
+	//libm in single precision
+	struct Float
+	{
+		using Real = float;
+		static constexpr const char* name = "float";
+		static constexpr bool exact = false;
+		static Real Sin(Real x)
+		{
+			return std::sin(x);
+		}
+		static Real Cos(Real x)
+		{
+			return std::cos(x);
+		}
+		static Real Exp(Real x)
+		{
+			return std::exp(x);
+		}
+	};
+
+	//What experiments run when none is asked for
+	using Default = std::conditional_t<simdKernelEnabled, FastPoly, Libm>;
+}
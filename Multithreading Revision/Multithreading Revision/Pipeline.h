@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Channel.h"
+#include "ThreadPool.h"
+
+namespace tk
+{
+	//Chain of stages running as long-lived tasks on a ThreadPool, connected by bounded channels.
+	//Every stage worker occupies a pool thread until its input is drained, so all of them are
+	//launched together as one gang by Wait() and their total must not exceed the pool's worker count.
+	class Pipeline
+	{
+	public:
+		Pipeline(ThreadPool& pool, size_t channelCapacity = 4)
+			:
+			pool{ pool },
+			channelCapacity{ channelCapacity }
+		{}
+		Pipeline(const Pipeline&) = delete;
+		Pipeline& operator = (const Pipeline&) = delete;
+
+		//generate() -> std::optional<T>, an empty optional ends the stream
+		template<typename F>
+		auto Source(F&& generate)
+		{
+			using T = typename std::invoke_result_t<F&>::value_type;
+			auto out = std::make_shared<Channel<T>>(channelCapacity);
+			members.push_back([out, generate = std::forward<F>(generate)]() mutable
+			{
+				try {
+					while (auto item = generate())
+					{
+						if (!out->Push(std::move(*item)))
+						{
+							break;
+						}
+					}
+				}
+				catch (...)
+				{
+					out->Close();
+					throw;
+				}
+				out->Close();
+			});
+			return out;
+		}
+
+		//transform(T) -> U, run by parallelism workers sharing the input channel
+		template<typename T, typename F>
+		auto Stage(std::shared_ptr<Channel<T>> in, F&& transform, size_t parallelism = 1)
+		{
+			using U = std::invoke_result_t<F&, T>;
+			auto out = std::make_shared<Channel<U>>(channelCapacity);
+			auto remaining = std::make_shared<std::atomic<size_t>>(parallelism);
+			auto shared = std::make_shared<std::decay_t<F>>(std::forward<F>(transform));
+			for (size_t i = 0; i < parallelism; i++)
+			{
+				members.push_back([in, out, remaining, shared]
+				{
+					try {
+						while (auto item = in->Pop())
+						{
+							if (!out->Push((*shared)(std::move(*item))))
+							{
+								in->Close(); //Downstream is gone, stop upstream too
+								break;
+							}
+						}
+					}
+					catch (...)
+					{
+						//Unblock both neighbours so the whole chain unwinds
+						in->Close();
+						out->Close();
+						throw;
+					}
+					if (remaining->fetch_sub(1) == 1)
+					{
+						out->Close();
+					}
+				});
+			}
+			return out;
+		}
+
+		//consume(T), single threaded so it can reduce into unsynchronised state
+		template<typename T, typename F>
+		void Sink(std::shared_ptr<Channel<T>> in, F&& consume)
+		{
+			members.push_back([in, consume = std::forward<F>(consume)]() mutable
+			{
+				try {
+					while (auto item = in->Pop())
+					{
+						consume(std::move(*item));
+					}
+				}
+				catch (...)
+				{
+					in->Close();
+					throw;
+				}
+			});
+		}
+
+		//Launches every stage and blocks until all have finished, rethrows the first stage exception
+		void Wait()
+		{
+			auto stages = std::make_shared<std::vector<std::move_only_function<void()>>>(std::move(members));
+			members.clear();
+			auto stageFutures = pool.RunGang(stages->size(), [stages](size_t i) {(*stages)[i](); });
+
+			std::exception_ptr error;
+			for (auto& f : stageFutures)
+			{
+				try {
+					f.get();
+				}
+				catch (...)
+				{
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+				}
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+	private:
+		ThreadPool& pool;
+		size_t channelCapacity;
+		std::vector<std::move_only_function<void()>> members;
+	};
+}
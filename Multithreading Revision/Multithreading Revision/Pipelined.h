@@ -0,0 +1,116 @@
+#pragma once
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+
+#include "Constants.h"
+#include "Task.h"
+#include "Timing.h"
+#include "Timer.h"
+#include "Runtime.h"
+#include "Pipeline.h"
+#include "AllocationProfiler.h"
+#include "Kernel.h"
+#include "HugePages.h"
+#include "CounterRng.h"
+
+namespace pip
+{
+	struct ChunkJob
+	{
+		size_t index = 0;
+		std::unique_ptr<Chunk> chunk;
+	};
+
+	struct ChunkResult
+	{
+		unsigned int sum = 0;
+		unsigned int reference = 0; //Exact sum, only filled in for inexact math policies
+		StreamChunkTimeInfo timing{};
+	};
+
+	//Generate -> Process -> Reduce streamed through the pool, only a few chunks are ever resident.
+	//Chunks are the ones rng::Generate<Dataset, Make> makes, so results match the other strategies
+	template<math::Policy Math = math::Default, rng::TaskFunction Make = rng::RandomTask>
+	int Experiment(size_t workerCount = tk::DefaultWorkerCount(), size_t chunkCount = ChunkCount, uint64_t seed = rng::DefaultSeed,
+		double probabilityHeavy = ProbabilityHeavy, double errorBound = MathErrorBound, size_t channelCapacity = 4)
+	{
+		alloc::Scope experimentScope{ "experiment" };
+		kernel::Prepare<Math>();
+		const auto tlbMisses = mem::TlbMisses();
+		Timer totalTime;
+		totalTime.Mark();
+
+		auto& pool = tk::Runtime();
+
+		//Source and sink mostly sleep on their channels, so processing gets the whole CPU budget
+		//as long as the pool still has room for those two
+		const auto processWorkers = std::clamp<size_t>(workerCount, 1, std::max<size_t>(pool.GetWorkerCount(), 3) - 2);
+
+		tk::Pipeline pipeline{ pool, channelCapacity };
+
+		auto chunks = pipeline.Source([index = size_t(0), chunkCount, seed, probabilityHeavy]() mutable -> std::optional<ChunkJob>
+		{
+			alloc::Scope scope{ "chunk.generate" };
+			if (index == chunkCount)
+			{
+				return {};
+			}
+			ChunkJob job{ .index = index++, .chunk = std::make_unique<Chunk>() };
+			rng::FillChunk<Make>(*job.chunk, job.index, seed, probabilityHeavy);
+			return job;
+		});
+
+		auto results = pipeline.Stage(chunks, [](ChunkJob job)
+		{
+			alloc::NoAllocationScope scope{ "chunk.process" };
+			Timer timer;
+			ChunkResult result;
+			result.timing.chunkIndex = job.index;
+			const auto view = MakeView(*job.chunk);
+			result.sum = kernel::Process<Math>(view);
+			if constexpr (timingMeasurementEnabled)
+			{
+				result.timing.numberOfHeavy = view.HeavyCount();
+				result.timing.workTime = timer.Peek();
+			}
+			if constexpr (!Math::exact)
+			{
+				result.reference = jump::Process(view);
+			}
+			return result;
+		}, processWorkers);
+
+		unsigned int result = 0;
+		unsigned int reference = 0;
+		std::vector<StreamChunkTimeInfo> timings;
+		timings.reserve(chunkCount);
+		pipeline.Sink(results, [&](ChunkResult chunkResult)
+		{
+			result += chunkResult.sum;
+			reference += chunkResult.reference;
+			if constexpr (timingMeasurementEnabled)
+			{
+				timings.push_back(chunkResult.timing);
+			}
+		});
+
+		pipeline.Wait();
+
+		auto t = totalTime.Peek();
+		std::cout << "Processing took " << t << " seconds\n";
+		mem::Report(std::cout, tlbMisses);
+		std::cout << "Result is " << result << std::endl;
+		const bool withinBound = kernel::Verify<Math>(result, reference, std::cout, errorBound);
+
+		if constexpr (timingMeasurementEnabled)
+		{
+			//Chunks leave the process stage out of order
+			std::ranges::sort(timings, {}, &StreamChunkTimeInfo::chunkIndex);
+			WriteCSV(timings);
+		}
+		return withinBound ? 0 : 1;
+	}
+}
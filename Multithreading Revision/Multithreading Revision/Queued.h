@@ -1,232 +1,52 @@
 #pragma once
-#include <iostream>
-#include <thread>
-#include <mutex>
-#include <span>
-#include <format>
+#include <utility>
 
 #include "Constants.h"
 #include "Task.h"
-#include "Timing.h"
-#include "Timer.h"
+#include "ChunkView.h"
+#include "Runtime.h"
+#include "Workload.h"
+#include "ShardedRange.h"
+#include "Engine.h"
 
 namespace que
 {
-	class WorkerControllerQueued
+	//One task at a time under the lock of the worker's claim group rather than one lock for the chunk
+	struct Distribution
 	{
-	public:
-		WorkerControllerQueued() : lk{ mtx } {}
-		void SignalDone()
+		template<typename View, Workload W>
+		class For
 		{
-			bool needsNotification = false;
-			{
-				std::lock_guard lk{ mtx };
-				++doneCount;
-				if (doneCount == WorkerCount)
-				{
-					needsNotification = true;
-
-				}
-			}
-
-			if (needsNotification)
-			{
-				cv.notify_one();
-			}
-		}
-
-		void WaitForAllDone()
-		{
-			cv.wait(lk, [this] {return doneCount == WorkerCount; });
-			doneCount = 0;
-		}
-
-		void SetChunk(std::span<const Task> chunk)
-		{
-			idx = 0;
-			currentChunk = chunk;
-		}
-
-		const Task* GetTask()
-		{
-			std::lock_guard lock{ mtx };
-			const auto i = idx++;
-			if (i >= ChunkSize)
-			{
-				return nullptr;
-			}
-			return &currentChunk[i];
-		}
-
-	private:
-		std::condition_variable cv;
-		std::mutex mtx; //Always Mutex with CV
-		std::unique_lock<std::mutex> lk;
-		std::span<const Task> currentChunk;
-		//Shared Memory
-		int doneCount = 0;
-		size_t idx = 0;
-	};
-
-	class WorkerQueued
-	{
-	public:
-		WorkerQueued(WorkerControllerQueued* pWorkerController)
-			:
-			pController{ pWorkerController },
-			thread{ &WorkerQueued::Run_, this }
-		{}
-
-		void StartWork()
-		{
-			{
-				std::lock_guard lk{ mtx };
-				working = true;
-			}
-			cv.notify_one();
-		}
-
-		void Kill()
-		{
-			{
-				std::lock_guard lk{ mtx };
-				terminate = true;
-			}
-			cv.notify_one();
-		}
-
-		unsigned int GetResult() const
-		{
-			return accululation;
-		}
-
-		float GetJobWorkTime() const
-		{
-			return workTime;
-		}
-
-		size_t GetNumHeavy() const
-		{
-			return numHeavyItems;
-		}
+		public:
+			explicit For(size_t workerCount) : ranges{ workerCount } {}
 
-		~WorkerQueued()
-		{
-			Kill();
-		}
-
-	private:
-		void ProcessData_()
-		{
-			numHeavyItems = 0;
-			while (auto pTask = pController->GetTask())
+			void SetChunk(View chunk)
 			{
-				accululation += pTask->Process();
-
-				if constexpr (timingMeasurementEnabled)
-				{
-					numHeavyItems += pTask->heavy;
-				}
+				ranges.Reset(chunk.size());
+				currentChunk = chunk;
 			}
-		}
 
-		void Run_()
-		{
-			std::unique_lock lk{ mtx };
-			while (true)
+			template<typename Sink>
+			void Process(size_t worker, Sink& sink)
 			{
-				Timer timer;
-				cv.wait(lk, [this] {return working || terminate; });
-				if (terminate)
+				size_t group = ranges.HomeGroup(worker);
+				while (const auto task = ranges.Claim(group, [](size_t, size_t) {return size_t(1); }))
 				{
-					break;
+					sink.Range(currentChunk.Subview(task->first, task->second));
 				}
-
-				if constexpr (timingMeasurementEnabled)
-				{
-					timer.Mark();
-				}
-				ProcessData_();
-				if constexpr (timingMeasurementEnabled)
-				{
-					workTime = timer.Peek();
-				}
-
-				working = false;
-				pController->SignalDone();
 			}
-		}
-		WorkerControllerQueued* pController;
-		std::jthread thread;
-		std::condition_variable cv;
-		std::mutex mtx;
 
-		//Shared Memory
-		unsigned int accululation = 0;
-		bool terminate = false;
-		bool working = false;
-		float workTime = -1.f;
-		size_t numHeavyItems;
+		private:
+			//Read by every claim, written only between chunks. The claim counters live in ranges' own cache lines
+			View currentChunk;
+			tk::ShardedRange<true> ranges;
+		};
 	};
 
-	int Experiment(Dataset chunks)
+	//Runs any Workload, Task data as a Dataset or an SoaDataset
+	template<Workload W = TaskWorkload<>, typename Data>
+	int Experiment(Data chunks, size_t workerCount = tk::DefaultWorkerCount(), W workload = W{})
 	{
-			Timer totalTime;
-			totalTime.Mark();
-
-			//Create Worker Threads
-			WorkerControllerQueued workerController; //Initialise Controller
-			std::vector<std::unique_ptr<WorkerQueued>> workerPtrs(WorkerCount);
-			std::ranges::generate(workerPtrs, [&workerController] {return std::make_unique<WorkerQueued>(&workerController); });
-
-			std::vector<ChunkTimeInfo> timings;
-			timings.reserve(ChunkCount);
-
-			Timer chunkTimer;
-			for (const auto& chunk : chunks)
-			{
-				if constexpr (timingMeasurementEnabled)
-				{
-					chunkTimer.Mark();
-				}
-
-				workerController.SetChunk(chunk);
-				for (const auto& w : workerPtrs)
-				{
-					w->StartWork();
-					//workerPtrs[iSubset]->SetJob(std::span{ &chunk[iSubset * SubsetSize], SubsetSize });
-					//workerThreads.push_back(std::jthread{ ProcessData, std::span{&datasets[j][i], subsetSize}, std::ref(sum[j].i)});
-				}
-				workerController.WaitForAllDone();
-
-				const auto chunkTime = chunkTimer.Peek();
-
-				if constexpr (timingMeasurementEnabled)
-				{
-					timings.push_back({});
-					for (size_t i = 0; i < WorkerCount; i++)
-					{
-						timings.back().numberOfHeavyPerThread[i] = workerPtrs[i]->GetNumHeavy();
-						timings.back().timeSpentWorkingPerThread[i] = workerPtrs[i]->GetJobWorkTime();
-					}
-					timings.back().totalChunkTime = chunkTime;
-				}
-			}
-
-			auto t = totalTime.Peek();
-			std::cout << "Processing took " << t << " seconds\n";
-
-			unsigned int result = 0;
-			for (const auto& w : workerPtrs)
-			{
-				result += w->GetResult();
-			}
-			std::cout << "Result is " << result << std::endl;
-
-			if constexpr (timingMeasurementEnabled)
-			{
-				WriteCSV(timings);
-			}
-			return 0;
+		return eng::Engine<Distribution>::Experiment(std::move(chunks), workerCount, std::move(workload));
 	}
-}
\ No newline at end of file
+}
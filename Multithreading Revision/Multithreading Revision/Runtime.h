@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "Constants.h"
+#include "ThreadPool.h"
+#include "CpuBudget.h"
+#include "HugePages.h"
+
+namespace tk
+{
+	//Re-reads the CPU budget periodically and keeps the runtime's concurrency limit inside it,
+	//so a container whose cgroup quota is changed at runtime stops being throttled
+	class CpuBudgetMonitor
+	{
+	public:
+		CpuBudgetMonitor(ThreadPool& pool, std::chrono::milliseconds interval = std::chrono::seconds{ 1 })
+			:
+			pool{ pool },
+			budget{ DetectCpuBudget() }
+		{
+			Apply_();
+			thread = std::jthread{ [this, interval](std::stop_token st) {Run_(st, interval); } };
+		}
+
+		CpuBudget GetBudget() const
+		{
+			std::lock_guard lk{ mtx };
+			return budget;
+		}
+
+	private:
+		void Apply_()
+		{
+			detail::budgetWorkers = budget.Workers();
+			const auto forced = detail::workerOverride.load();
+			pool.SetConcurrencyLimit(forced ? forced : budget.Workers());
+		}
+
+		void Run_(std::stop_token st, std::chrono::milliseconds interval)
+		{
+			std::mutex sleepMtx;
+			std::condition_variable_any sleepCV;
+			std::unique_lock sleepLk{ sleepMtx };
+			while (!sleepCV.wait_for(sleepLk, st, interval, [] {return false; }) && !st.stop_requested())
+			{
+				const auto latest = DetectCpuBudget();
+				std::lock_guard lk{ mtx };
+				if (latest != budget)
+				{
+					budget = latest;
+					Apply_();
+				}
+			}
+		}
+
+		ThreadPool& pool;
+		mutable std::mutex mtx;
+		CpuBudget budget;
+		std::jthread thread;
+	};
+
+	//Process-wide pool of warm, persistent workers. Experiments, pipelines and ad-hoc tasks
+	//all schedule onto it instead of spinning up their own threads. It has a thread per core,
+	//but only as many run tenant tasks at once as the CPU budget allows
+	inline ThreadPool& Runtime()
+	{
+		//Every worker opens its own dTLB counter, a counter only takes in a thread's counts once it exits
+		static ThreadPool pool{ std::max({ WorkerCount, size_t(std::thread::hardware_concurrency()), detail::workerOverride.load() }), mem::CountTlbMisses };
+		static CpuBudgetMonitor monitor{ pool };
+		return pool;
+	}
+
+	//Runs f(i) for every i in [0, count), split into one slice per budgeted worker, and waits.
+	//Blocks on the runtime, so call it from outside its workers
+	template<typename F>
+	void ParallelFor(size_t count, F&& f)
+	{
+		const auto slices = std::clamp<size_t>(DefaultWorkerCount(), 1, std::max<size_t>(count, 1));
+		std::vector<std::future<void>> futures;
+		futures.reserve(slices);
+		for (size_t i = 0; i < slices; i++)
+		{
+			futures.push_back(Runtime().Run([&f, begin = i * count / slices, end = (i + 1) * count / slices]
+			{
+				for (auto j = begin; j < end; j++)
+				{
+					f(j);
+				}
+			}));
+		}
+		for (auto& future : futures)
+		{
+			future.get();
+		}
+	}
+
+	//Owns a set of experiment workers whose Run() loops are gang-scheduled on the runtime.
+	//W needs Run() (returns once killed) and Kill(). The workers sit in one contiguous array aligned for W,
+	//so a W aligned to the destructive interference size never shares a cache line with its neighbours
+	template<typename W>
+	class Crew
+	{
+	public:
+		template<typename ...A>
+		Crew(size_t count, A&& ...args)
+			:
+			storage{ static_cast<W*>(::operator new(std::max<size_t>(count, 1) * sizeof(W), std::align_val_t{ alignof(W) })) }
+		{
+			workers.reserve(count);
+			try {
+				for (size_t i = 0; i < count; i++)
+				{
+					workers.push_back(::new (storage.get() + i) W(args...));
+				}
+				loops = Runtime().RunGang(count, [this](size_t i) {workers[i]->Run(); });
+			}
+			catch (...)
+			{
+				Destroy_();
+				throw;
+			}
+		}
+		Crew(const Crew&) = delete;
+		Crew& operator = (const Crew&) = delete;
+
+		W* operator[](size_t i)
+		{
+			return workers[i];
+		}
+		auto begin()
+		{
+			return workers.begin();
+		}
+		auto end()
+		{
+			return workers.end();
+		}
+		size_t size() const
+		{
+			return workers.size();
+		}
+
+		~Crew()
+		{
+			//Loops must be finished before the workers they run on are destroyed
+			for (auto& w : workers)
+			{
+				w->Kill();
+			}
+			for (auto& l : loops)
+			{
+				l.wait();
+			}
+			Destroy_();
+		}
+
+	private:
+		struct Free
+		{
+			void operator()(W* p) const
+			{
+				::operator delete(p, std::align_val_t{ alignof(W) });
+			}
+		};
+
+		void Destroy_()
+		{
+			while (!workers.empty())
+			{
+				std::destroy_at(workers.back());
+				workers.pop_back();
+			}
+		}
+
+		std::unique_ptr<W, Free> storage;
+		std::vector<W*> workers;
+		std::vector<std::future<void>> loops;
+	};
+}
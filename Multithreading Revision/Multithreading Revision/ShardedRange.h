@@ -0,0 +1,154 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+
+namespace tk
+{
+	//[0, total) split into groups of about ClaimGroupWorkers workers, each group with its own counter on its
+	//own cache line. Workers claim from their home group and move on to the next groups once it is used up,
+	//so a counter is only shared within a group until the range runs dry. Locked puts each counter behind
+	//its group's mutex instead of making it atomic
+	template<bool Locked = false>
+	class ShardedRange
+	{
+	public:
+		//groupCount 0 makes groups of ClaimGroupWorkers, 1 is a single shared counter
+		explicit ShardedRange(size_t workerCount, size_t groupCount = 0)
+			:
+			workerCount{ std::max<size_t>(workerCount, 1) },
+			groups(groupCount ? groupCount : (this->workerCount + ClaimGroupWorkers - 1) / ClaimGroupWorkers)
+		{}
+
+		//Call while no worker is claiming
+		void Reset(size_t total)
+		{
+			for (size_t g = 0; g < groups.size(); g++)
+			{
+				groups[g].begin = g * total / groups.size();
+				groups[g].end = (g + 1) * total / groups.size();
+				groups[g].next.store(groups[g].begin, std::memory_order_relaxed);
+			}
+		}
+
+		size_t HomeGroup(size_t worker) const
+		{
+			return worker * groups.size() / workerCount;
+		}
+
+		//Workers sharing a group, for sizing claims
+		size_t GroupWorkers() const
+		{
+			return (workerCount + groups.size() - 1) / groups.size();
+		}
+
+		//Claims [first, second) of at most size(offset in group, group size) tasks, starting from group and
+		//leaving group at whichever group it was taken from. Empty once every group is used up.
+		//FixedSize: size doesn't depend on the offset, so the atomic counter can take it with one fetch_add
+		template<bool FixedSize = false, typename F>
+		std::optional<std::pair<size_t, size_t>> Claim(size_t& group, F&& size)
+		{
+			for (size_t tried = 0; tried < groups.size(); tried++, group = (group + 1) % groups.size())
+			{
+				auto& g = groups[group];
+				if constexpr (Locked)
+				{
+					std::lock_guard lk{ g.mtx };
+					const auto start = g.next.load(std::memory_order_relaxed);
+					if (start < g.end)
+					{
+						const auto end = std::min(start + std::max<size_t>(size(start - g.begin, g.end - g.begin), 1), g.end);
+						g.next.store(end, std::memory_order_relaxed);
+						return std::pair{ start, end };
+					}
+				}
+				else if constexpr (FixedSize)
+				{
+					if (g.next.load(std::memory_order_relaxed) < g.end)
+					{
+						const auto n = std::max<size_t>(size(0, g.end - g.begin), 1);
+						const auto start = g.next.fetch_add(n, std::memory_order_relaxed);
+						if (start < g.end)
+						{
+							return std::pair{ start, std::min(start + n, g.end) };
+						}
+					}
+				}
+				else
+				{
+					auto start = g.next.load(std::memory_order_relaxed);
+					while (start < g.end)
+					{
+						const auto n = std::max<size_t>(size(start - g.begin, g.end - g.begin), 1);
+						if (g.next.compare_exchange_weak(start, start + n, std::memory_order_relaxed))
+						{
+							return std::pair{ start, std::min(start + n, g.end) };
+						}
+					}
+				}
+			}
+			return {};
+		}
+
+	private:
+		struct alignas(std::hardware_destructive_interference_size) Group
+		{
+			std::atomic<size_t> next = 0;
+			size_t begin = 0;
+			size_t end = 0;
+			std::mutex mtx; //Only used when Locked
+		};
+
+		size_t workerCount;
+		std::vector<Group> groups;
+	};
+
+	//Cost of single-task claims with every worker hammering the counters, one shared counter against sharded ones.
+	//Plain threads rather than the runtime, so the worker count isn't capped by the pool
+	inline void BenchmarkClaims(std::ostream& out, std::vector<size_t> workerCounts = { 4, 16, 64, 128 }, size_t total = size_t(1) << 22)
+	{
+		const auto measure = [total](auto& range, size_t workers)
+		{
+			range.Reset(total);
+			std::atomic<size_t> ready = 0;
+			const auto begin = std::chrono::steady_clock::now();
+			{
+				std::vector<std::jthread> threads;
+				for (size_t w = 0; w < workers; w++)
+				{
+					threads.emplace_back([&, w]
+					{
+						++ready;
+						while (ready.load() < workers)
+						{
+							std::this_thread::yield();
+						}
+						auto group = range.HomeGroup(w);
+						while (range.template Claim<true>(group, [](size_t, size_t) {return size_t(1); }));
+					});
+				}
+			}
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / double(total);
+		};
+
+		out << "workers, groups, shared ns/claim, sharded ns/claim, shared locked ns/claim, sharded locked ns/claim\n";
+		for (const auto workers : workerCounts)
+		{
+			ShardedRange<> shared{ workers, 1 }, sharded{ workers };
+			ShardedRange<true> sharedLocked{ workers, 1 }, shardedLocked{ workers };
+			out << std::format("{}, {}, {:.2f}, {:.2f}, {:.2f}, {:.2f}\n", workers, (workers + ClaimGroupWorkers - 1) / ClaimGroupWorkers,
+				measure(shared, workers), measure(sharded, workers), measure(sharedLocked, workers), measure(shardedLocked, workers));
+		}
+	}
+}
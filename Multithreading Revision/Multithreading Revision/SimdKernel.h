@@ -0,0 +1,374 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <ostream>
+#include <span>
+#include <format>
+#include <random>
+#include <vector>
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET(isa)
+#else
+#include <cpuid.h>
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "MathPolicy.h"
+
+//Batched Task::Process<math::FastPoly>. Lanes run the same iteration with polynomial sin/cos (Cephes coefficients,
+//quadrant reduction), light lanes are frozen by mask after LightIterations while heavy lanes carry on.
+//Every ISA path evaluates exactly the same operations, so scalar/AVX2/AVX-512 agree bit for bit.
+//Matching libm is not guaranteed: the digit truncation makes the iteration chaotic, so any task where
+//sin/cos land 1 ulp away from libm follows a different orbit. Validate() reports how close they are.
+namespace simd
+{
+	enum class Isa
+	{
+		Scalar,
+		Avx2,
+		Avx512,
+	};
+
+	inline const char* IsaName(Isa isa)
+	{
+		switch (isa)
+		{
+		case Isa::Avx512: return "AVX-512";
+		case Isa::Avx2: return "AVX2";
+		default: return "Scalar";
+		}
+	}
+
+	namespace detail
+	{
+		using namespace math::poly;
+
+		inline void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+		{
+#if defined(_MSC_VER)
+			int r[4];
+			__cpuidex(r, int(leaf), int(subleaf));
+			for (int i = 0; i < 4; i++)
+			{
+				regs[i] = uint32_t(r[i]);
+			}
+#else
+			__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		}
+
+		inline uint64_t Xgetbv()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32_t eax, edx;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return (uint64_t(edx) << 32) | eax;
+#endif
+		}
+
+		inline double StepApprox(double x)
+		{
+			const auto s = SinCosApprox(SinCosApprox(x, true) * std::numbers::pi, false);
+			const auto t = std::trunc(std::abs(s * 10'000'000.));
+			return (t - std::floor(t / 100'000.) * 100'000.) / 10'000.;
+		}
+
+		template<ChunkViewType View>
+		unsigned int ProcessScalar(const View& tasks)
+		{
+			unsigned int sum = 0;
+			for (size_t t = 0; t < tasks.size(); t++)
+			{
+				const Task task = tasks[t];
+				const auto iterations = task.heavy ? HeavyIterations : LightIterations;
+				auto intermediate = task.val;
+				for (size_t i = 0; i < iterations; i++)
+				{
+					intermediate = StepApprox(intermediate);
+				}
+				sum += (unsigned int)(std::exp(intermediate));
+			}
+			return sum;
+		}
+
+		SIMD_TARGET("avx2") inline __m256d Horner256(__m256d z, double c0, double c1, double c2, double c3, double c4, double c5)
+		{
+			auto p = _mm256_set1_pd(c0);
+			for (const auto c : { c1, c2, c3, c4, c5 })
+			{
+				p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(c));
+			}
+			return p;
+		}
+
+		SIMD_TARGET("avx2") inline __m256d SinCos256(__m256d x, bool cosine)
+		{
+			const auto q = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(TwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			const auto r = _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(q, _mm256_set1_pd(PiO2_1))), _mm256_mul_pd(q, _mm256_set1_pd(PiO2_2))), _mm256_mul_pd(q, _mm256_set1_pd(PiO2_3)));
+			const auto z = _mm256_mul_pd(r, r);
+			const auto sinr = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), Horner256(z, S0, S1, S2, S3, S4, S5)));
+			const auto cosr = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.), _mm256_mul_pd(_mm256_set1_pd(0.5), z)), _mm256_mul_pd(_mm256_mul_pd(z, z), Horner256(z, C0, C1, C2, C3, C4, C5)));
+			const auto odd = _mm256_cmp_pd(_mm256_sub_pd(q, _mm256_mul_pd(_mm256_set1_pd(2.), _mm256_floor_pd(_mm256_mul_pd(q, _mm256_set1_pd(0.5))))), _mm256_set1_pd(1.), _CMP_EQ_OQ);
+			const auto high = _mm256_cmp_pd(_mm256_sub_pd(q, _mm256_mul_pd(_mm256_set1_pd(4.), _mm256_floor_pd(_mm256_mul_pd(q, _mm256_set1_pd(0.25))))), _mm256_set1_pd(2.), _CMP_GE_OQ);
+			const auto v = cosine ? _mm256_blendv_pd(cosr, sinr, odd) : _mm256_blendv_pd(sinr, cosr, odd);
+			const auto negate = cosine ? _mm256_xor_pd(odd, high) : high;
+			return _mm256_xor_pd(v, _mm256_and_pd(negate, _mm256_set1_pd(-0.)));
+		}
+
+		SIMD_TARGET("avx2") inline __m256d Step256(__m256d x)
+		{
+			const auto s = SinCos256(_mm256_mul_pd(SinCos256(x, true), _mm256_set1_pd(std::numbers::pi)), false);
+			const auto t = _mm256_round_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.), _mm256_mul_pd(s, _mm256_set1_pd(10'000'000.))), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+			const auto k = _mm256_floor_pd(_mm256_div_pd(t, _mm256_set1_pd(100'000.)));
+			return _mm256_div_pd(_mm256_sub_pd(t, _mm256_mul_pd(k, _mm256_set1_pd(100'000.))), _mm256_set1_pd(10'000.));
+		}
+
+		template<ChunkViewType View>
+		SIMD_TARGET("avx2") unsigned int ProcessAvx2(const View& tasks)
+		{
+			unsigned int sum = 0;
+			size_t i = 0;
+			for (; i + 4 <= tasks.size(); i += 4)
+			{
+				__m256d x, heavy;
+				if constexpr (View::contiguousValues)
+				{
+					//SoA: one load for the values, the heavy bits spread into lane masks
+					x = _mm256_loadu_pd(tasks.Values() + i);
+					const auto laneBits = _mm256_setr_epi64x(1, 2, 4, 8);
+					const auto bits = _mm256_set1_epi64x(int64_t(tasks.HeavyBits(i, 4)));
+					heavy = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(bits, laneBits), laneBits));
+				}
+				else
+				{
+					const Task t[4] = { tasks[i], tasks[i + 1], tasks[i + 2], tasks[i + 3] };
+					x = _mm256_setr_pd(t[0].val, t[1].val, t[2].val, t[3].val);
+					heavy = _mm256_castsi256_pd(_mm256_setr_epi64x(-int64_t(t[0].heavy), -int64_t(t[1].heavy), -int64_t(t[2].heavy), -int64_t(t[3].heavy)));
+				}
+				for (size_t it = 0; it < LightIterations; it++)
+				{
+					x = Step256(x);
+				}
+				if (_mm256_movemask_pd(heavy))
+				{
+					for (size_t it = LightIterations; it < HeavyIterations; it++)
+					{
+						x = _mm256_blendv_pd(x, Step256(x), heavy);
+					}
+				}
+				alignas(32) double lanes[4];
+				_mm256_store_pd(lanes, x);
+				for (const auto v : lanes)
+				{
+					sum += (unsigned int)(std::exp(v));
+				}
+			}
+			return sum + ProcessScalar(tasks.Subview(i, tasks.size()));
+		}
+
+		SIMD_TARGET("avx512f") inline __m512d Horner512(__m512d z, double c0, double c1, double c2, double c3, double c4, double c5)
+		{
+			auto p = _mm512_set1_pd(c0);
+			for (const auto c : { c1, c2, c3, c4, c5 })
+			{
+				p = _mm512_add_pd(_mm512_mul_pd(p, z), _mm512_set1_pd(c));
+			}
+			return p;
+		}
+
+		SIMD_TARGET("avx512f") inline __m512d SinCos512(__m512d x, bool cosine)
+		{
+			const auto q = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(TwoOverPi)), _MM_FROUND_TO_NEAREST_INT);
+			const auto r = _mm512_sub_pd(_mm512_sub_pd(_mm512_sub_pd(x, _mm512_mul_pd(q, _mm512_set1_pd(PiO2_1))), _mm512_mul_pd(q, _mm512_set1_pd(PiO2_2))), _mm512_mul_pd(q, _mm512_set1_pd(PiO2_3)));
+			const auto z = _mm512_mul_pd(r, r);
+			const auto sinr = _mm512_add_pd(r, _mm512_mul_pd(_mm512_mul_pd(r, z), Horner512(z, S0, S1, S2, S3, S4, S5)));
+			const auto cosr = _mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(1.), _mm512_mul_pd(_mm512_set1_pd(0.5), z)), _mm512_mul_pd(_mm512_mul_pd(z, z), Horner512(z, C0, C1, C2, C3, C4, C5)));
+			const __mmask8 odd = _mm512_cmp_pd_mask(_mm512_sub_pd(q, _mm512_mul_pd(_mm512_set1_pd(2.), _mm512_roundscale_pd(_mm512_mul_pd(q, _mm512_set1_pd(0.5)), _MM_FROUND_TO_NEG_INF))), _mm512_set1_pd(1.), _CMP_EQ_OQ);
+			const __mmask8 high = _mm512_cmp_pd_mask(_mm512_sub_pd(q, _mm512_mul_pd(_mm512_set1_pd(4.), _mm512_roundscale_pd(_mm512_mul_pd(q, _mm512_set1_pd(0.25)), _MM_FROUND_TO_NEG_INF))), _mm512_set1_pd(2.), _CMP_GE_OQ);
+			const auto v = cosine ? _mm512_mask_blend_pd(odd, cosr, sinr) : _mm512_mask_blend_pd(odd, sinr, cosr);
+			const __mmask8 negate = cosine ? __mmask8(odd ^ high) : high;
+			const auto bits = _mm512_castpd_si512(v);
+			return _mm512_castsi512_pd(_mm512_mask_xor_epi64(bits, negate, bits, _mm512_set1_epi64(INT64_MIN)));
+		}
+
+		SIMD_TARGET("avx512f") inline __m512d Step512(__m512d x)
+		{
+			const auto s = SinCos512(_mm512_mul_pd(SinCos512(x, true), _mm512_set1_pd(std::numbers::pi)), false);
+			const auto t = _mm512_roundscale_pd(_mm512_abs_pd(_mm512_mul_pd(s, _mm512_set1_pd(10'000'000.))), _MM_FROUND_TO_ZERO);
+			const auto k = _mm512_roundscale_pd(_mm512_div_pd(t, _mm512_set1_pd(100'000.)), _MM_FROUND_TO_NEG_INF);
+			return _mm512_div_pd(_mm512_sub_pd(t, _mm512_mul_pd(k, _mm512_set1_pd(100'000.))), _mm512_set1_pd(10'000.));
+		}
+
+		template<ChunkViewType View>
+		SIMD_TARGET("avx512f") unsigned int ProcessAvx512(const View& tasks)
+		{
+			unsigned int sum = 0;
+			size_t i = 0;
+			for (; i + 8 <= tasks.size(); i += 8)
+			{
+				alignas(64) double values[8];
+				__m512d x;
+				__mmask8 heavy = 0;
+				if constexpr (View::contiguousValues)
+				{
+					x = _mm512_loadu_pd(tasks.Values() + i);
+					heavy = __mmask8(tasks.HeavyBits(i, 8));
+				}
+				else
+				{
+					for (int l = 0; l < 8; l++)
+					{
+						const Task t = tasks[i + l];
+						values[l] = t.val;
+						heavy |= __mmask8(t.heavy) << l;
+					}
+					x = _mm512_load_pd(values);
+				}
+				for (size_t it = 0; it < LightIterations; it++)
+				{
+					x = Step512(x);
+				}
+				if (heavy)
+				{
+					for (size_t it = LightIterations; it < HeavyIterations; it++)
+					{
+						x = _mm512_mask_blend_pd(heavy, x, Step512(x));
+					}
+				}
+				_mm512_store_pd(values, x);
+				for (const auto v : values)
+				{
+					sum += (unsigned int)(std::exp(v));
+				}
+			}
+			return sum + ProcessAvx2(tasks.Subview(i, tasks.size()));
+		}
+	}
+
+	//Best ISA the CPU and OS both support
+	inline Isa DetectIsa()
+	{
+		uint32_t r[4];
+		detail::Cpuid(0, 0, r);
+		const auto maxLeaf = r[0];
+		if (maxLeaf < 7)
+		{
+			return Isa::Scalar;
+		}
+		detail::Cpuid(1, 0, r);
+		const bool osxsave = r[2] & (1u << 27);
+		const bool avx = r[2] & (1u << 28);
+		if (!osxsave || !avx)
+		{
+			return Isa::Scalar;
+		}
+		const auto xcr0 = detail::Xgetbv();
+		detail::Cpuid(7, 0, r);
+		const bool avx2 = (r[1] & (1u << 5)) && (xcr0 & 0x6) == 0x6;
+		const bool avx512 = (r[1] & (1u << 16)) && (xcr0 & 0xE6) == 0xE6;
+		return avx512 ? Isa::Avx512 : avx2 ? Isa::Avx2 : Isa::Scalar;
+	}
+
+	inline Isa ActiveIsa()
+	{
+		static const Isa isa = DetectIsa();
+		return isa;
+	}
+
+	//Sum of the approximate Process() over tasks on the given ISA
+	template<ChunkViewType View>
+	unsigned int Process(const View& tasks, Isa isa = ActiveIsa())
+	{
+		switch (isa)
+		{
+		case Isa::Avx512: return detail::ProcessAvx512(tasks);
+		case Isa::Avx2: return detail::ProcessAvx2(tasks);
+		default: return detail::ProcessScalar(tasks);
+		}
+	}
+
+	inline unsigned int Process(std::span<const Task> tasks, Isa isa = ActiveIsa())
+	{
+		return Process(AosChunkView{ tasks }, isa);
+	}
+
+	//Collects tasks handed out one at a time (queued strategies) into full vector batches
+	class Batch
+	{
+	public:
+		static constexpr size_t Size = 8;
+		//Returns the sum of a batch whenever one fills up, otherwise 0
+		unsigned int Push(const Task& task)
+		{
+			pending[count++] = task;
+			return count == Size ? Flush() : 0;
+		}
+		unsigned int Flush()
+		{
+			const auto sum = Process(std::span{ pending.data(), count });
+			count = 0;
+			return sum;
+		}
+	private:
+		std::array<Task, Size> pending;
+		size_t count = 0;
+	};
+
+	//Checks the approximation against libm and the ISA paths against each other
+	inline bool Validate(std::ostream& out)
+	{
+		double maxSinError = 0., maxCosError = 0.;
+		for (int i = 0; i <= 1'000'000; i++)
+		{
+			const auto x = 10. * i / 1'000'000.; //Task values stay in [0, 10]
+			maxCosError = std::max(maxCosError, std::abs(detail::SinCosApprox(x, true) - std::cos(x)));
+			const auto y = std::numbers::pi * (2. * i / 1'000'000. - 1.); //cos * pi
+			maxSinError = std::max(maxSinError, std::abs(detail::SinCosApprox(y, false) - std::sin(y)));
+		}
+
+		std::minstd_rand rne;
+		std::bernoulli_distribution hDist{ ProbabilityHeavy };
+		std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
+		Dataset data(1);
+		auto& tasks = data.front();
+		std::ranges::generate(tasks, [&] {return Task{ .val = rDist(rne), .heavy = hDist(rne) }; });
+		const auto soa = ToSoa(data);
+
+		//Every ISA over both layouts has to land on the same sum
+		const auto scalar = Process(tasks, Isa::Scalar);
+		bool isaAgree = true;
+		for (const auto isa : { Isa::Scalar, Isa::Avx2, Isa::Avx512 })
+		{
+			if (isa <= ActiveIsa())
+			{
+				isaAgree &= Process(tasks, isa) == scalar;
+				isaAgree &= Process(SoaChunkView{ soa.front() }, isa) == scalar;
+			}
+		}
+		unsigned int reference = 0;
+		size_t sameTasks = 0;
+		for (const auto& task : tasks)
+		{
+			const auto exact = task.Process();
+			reference += exact;
+			sameTasks += exact == Process(std::span{ &task, 1 }, Isa::Scalar);
+		}
+
+		out << std::format("SIMD kernel ({}): max |sin err| {:.3}, max |cos err| {:.3}, ISA paths agree: {}\n",
+			IsaName(ActiveIsa()), maxSinError, maxCosError, isaAgree);
+		out << std::format("  chunk sum {} vs libm {} ({:.3}% apart), {:.1}% of tasks identical\n",
+			scalar, reference, 100. * std::abs(double(scalar) - double(reference)) / double(reference), 100. * double(sameTasks) / double(tasks.size()));
+		return isaAgree && maxSinError < 1e-15 && maxCosError < 1e-15;
+	}
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <format>
+#include <optional>
+#include <ostream>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "Runtime.h"
+#include "Workload.h"
+#include "Engine.h"
+
+//Preassignment with stealing: every worker starts on the subset pre would give it, taking StealGrain tasks
+//at a time from the front of its own range. A worker that runs out splits the largest range left and takes
+//its back half (lazy binary splitting), so work only moves once someone would otherwise idle.
+namespace stw
+{
+	//[begin, end) packed into one word so owner and thieves adjust it with a single CAS
+	class Range
+	{
+	public:
+		void Set(size_t begin, size_t end)
+		{
+			bounds.store(Pack_(begin, end), std::memory_order_relaxed);
+		}
+
+		size_t Size() const
+		{
+			const auto b = bounds.load(std::memory_order_relaxed);
+			return End_(b) - Begin_(b);
+		}
+
+		//Owner: up to grain tasks off the front
+		std::optional<std::pair<size_t, size_t>> TakeFront(size_t grain)
+		{
+			auto b = bounds.load(std::memory_order_relaxed);
+			while (Begin_(b) < End_(b))
+			{
+				const auto split = std::min(Begin_(b) + grain, End_(b));
+				if (bounds.compare_exchange_weak(b, Pack_(split, End_(b)), std::memory_order_relaxed))
+				{
+					return std::pair{ Begin_(b), split };
+				}
+			}
+			return {};
+		}
+
+		//Thief: the back half, all of it when one task is left
+		std::optional<std::pair<size_t, size_t>> TakeBack()
+		{
+			auto b = bounds.load(std::memory_order_relaxed);
+			while (Begin_(b) < End_(b))
+			{
+				const auto mid = Begin_(b) + (End_(b) - Begin_(b)) / 2;
+				if (bounds.compare_exchange_weak(b, Pack_(Begin_(b), mid), std::memory_order_relaxed))
+				{
+					return std::pair{ mid, End_(b) };
+				}
+			}
+			return {};
+		}
+
+	private:
+		static uint64_t Pack_(size_t begin, size_t end)
+		{
+			return uint64_t(begin) | uint64_t(end) << 32;
+		}
+		static size_t Begin_(uint64_t b)
+		{
+			return size_t(b & 0xFFFF'FFFF);
+		}
+		static size_t End_(uint64_t b)
+		{
+			return size_t(b >> 32);
+		}
+
+		alignas(std::hardware_destructive_interference_size) std::atomic<uint64_t> bounds = 0;
+	};
+
+
+	struct Distribution
+	{
+		template<typename View, Workload W>
+		class For
+		{
+		public:
+			explicit For(size_t workerCount) : workerCount{ workerCount }, ranges(workerCount), steals(workerCount) {}
+
+			//Every worker gets the subset pre would give it
+			void SetChunk(View chunk)
+			{
+				if (chunk.size() > 0xFFFF'FFFF)
+				{
+					throw std::length_error("Chunks for stealing must have fewer than 2^32 tasks");
+				}
+				currentChunk = chunk;
+				for (size_t i = 0; i < workerCount; i++)
+				{
+					//Even split, the remainder spreads over the later subsets
+					ranges[i].Set(i * chunk.size() / workerCount, (i + 1) * chunk.size() / workerCount);
+				}
+			}
+
+			template<typename Sink>
+			void Process(size_t worker, Sink& sink)
+			{
+				while (const auto range = Claim_(worker, steals[worker].count))
+				{
+					sink.Range(*range);
+				}
+			}
+
+			void Report(std::ostream& out, size_t chunkCount, size_t) const
+			{
+				size_t total = 0;
+				for (const auto& s : steals)
+				{
+					total += s.count;
+				}
+				out << std::format("{:.1f} steals per chunk\n", chunkCount ? double(total) / double(chunkCount) : 0.);
+			}
+
+		private:
+			//Next tasks for worker, from its own range while it lasts. Then the back half of the largest range
+			//left becomes its own range. Empty once every range is used up
+			std::optional<View> Claim_(size_t worker, size_t& numSteals)
+			{
+				while (true)
+				{
+					if (const auto own = ranges[worker].TakeFront(StealGrain))
+					{
+						return currentChunk.Subview(own->first, own->second);
+					}
+
+					size_t victim = worker;
+					size_t largest = 0;
+					for (size_t i = 0; i < workerCount; i++)
+					{
+						if (const auto size = ranges[i].Size(); i != worker && size > largest)
+						{
+							victim = i;
+							largest = size;
+						}
+					}
+					if (largest == 0)
+					{
+						return {};
+					}
+					if (const auto stolen = ranges[victim].TakeBack())
+					{
+						++numSteals;
+						ranges[worker].Set(stolen->first, stolen->second);
+					}
+				}
+			}
+
+			//Written by one worker each, totalled after the run
+			struct alignas(std::hardware_destructive_interference_size) Steals
+			{
+				size_t count = 0;
+			};
+
+			//Read-mostly
+			View currentChunk;
+			size_t workerCount;
+			std::vector<Range> ranges; //One per worker, each on its own cache line
+			std::vector<Steals> steals;
+		};
+	};
+
+	//Runs any Workload, Task data as a Dataset or an SoaDataset
+	template<Workload W = TaskWorkload<>, typename Data>
+	int Experiment(Data chunks, size_t workerCount = tk::DefaultWorkerCount(), W workload = W{})
+	{
+		return eng::Engine<Distribution>::Experiment(std::move(chunks), workerCount, std::move(workload));
+	}
+}
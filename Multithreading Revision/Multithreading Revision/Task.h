@@ -1,82 +1,54 @@
 #pragma once
-#include <random>
 #include <array>
-#include <ranges>
 #include <cmath>
 #include <numbers>
 
 #include "Constants.h"
+#include "MathPolicy.h"
+#include "HugePages.h"
 
 struct Task
 {
 	double val;
 	bool heavy;
+	//One iteration, the result is one of 100'000 digit states (intermediate = digits / 10'000.)
+	template<math::Policy Math = math::Libm>
+	static unsigned int Step(typename Math::Real intermediate)
+	{
+		using Real = typename Math::Real;
+		return unsigned int(std::abs(Math::Sin(Math::Cos(intermediate) * std::numbers::pi_v<Real>) * Real(10'000'000.))) % 100'000;
+	}
+	//Fixed trip count, so the compiler sees the whole dependent chain
+	template<size_t Iterations, math::Policy Math = math::Libm>
 	unsigned int Process() const
 	{
-		const auto iterations = heavy ? HeavyIterations : LightIterations;
-		auto intermediate = val;
-		for (size_t i = 0; i < iterations; i++)
+		using Real = typename Math::Real;
+		auto intermediate = Real(val);
+		for (size_t i = 0; i < Iterations; i++)
 		{
-			const auto digits = unsigned int(std::abs(std::sin(std::cos(intermediate) * std::numbers::pi) * 10'000'000.)) % 100'000;
-			intermediate = double(digits) / 10'000.; //Value between 0 and 10;
+			const auto digits = Step<Math>(intermediate);
+			intermediate = Real(digits) / Real(10'000.); //Value between 0 and 10;
 		}
-		return unsigned int(std::exp(intermediate));
-	};
-};
-
-using Dataset = std::vector<std::array<Task, ChunkSize>>;
-
-Dataset GenerateDataRandom()
-{
-	std::minstd_rand rne; //Random Number Engine 
-	std::bernoulli_distribution hDist{ ProbabilityHeavy }; //Heavy Distribution
-	std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
-
-	std::vector<std::array<Task, ChunkSize>> chunks(ChunkCount);
-
-	for (auto& chunk : chunks)
-	{
-		std::ranges::generate(chunk, [&] {return Task{ .val = rDist(rne), .heavy = hDist(rne) }; });
+		return unsigned int(Math::Exp(intermediate));
 	}
-
-	return chunks;
-}
-
-Dataset GenerateDataEvenly()
-{
-	std::minstd_rand rne; //Random Number Engine 
-
-	std::uniform_real_distribution rDist{ 0., 2. * std::numbers::pi };
-
-	const int everyNth = int(1. / ProbabilityHeavy);
-
-	std::vector<std::array<Task, ChunkSize>> chunks(ChunkCount);
-
-	for (auto& chunk : chunks)
+	template<math::Policy Math = math::Libm>
+	unsigned int Process() const
 	{
-		std::ranges::generate(chunk, [&, i = 0.]() mutable {
-			bool heavy = false;
-			if ((i += ProbabilityHeavy) >= 1.)
-			{
-				i -= 1.;
-				heavy = true;
-			}
-			return Task{ .val = rDist(rne), .heavy = heavy };
-			});
-	}
-
-	return chunks;
-}
-
-Dataset GenerateDataStacked()
-{
-	auto data = GenerateDataEvenly();
-
-	for (auto& chunk : data)
+		return heavy ? Process<HeavyIterations, Math>() : Process<LightIterations, Math>();
+	};
+	//Trip count chosen at runtime, for configurations the fixed-count kernels weren't compiled for
+	template<math::Policy Math = math::Libm>
+	unsigned int Process(size_t iterations) const
 	{
-		std::ranges::partition(chunk, std::identity{}, &Task::heavy);
+		using Real = typename Math::Real;
+		auto intermediate = Real(val);
+		for (size_t i = 0; i < iterations; i++)
+		{
+			intermediate = Real(Step<Math>(intermediate)) / Real(10'000.);
+		}
+		return (unsigned int)(Math::Exp(intermediate));
 	}
+};
 
-
-	return data;
-}
\ No newline at end of file
+using Chunk = std::array<Task, ChunkSize>;
+using Dataset = mem::Vector<Chunk>; //Huge page backed, see HugePages.h
@@ -0,0 +1,515 @@
+#pragma once
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <future>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <utility>
+#include <memory>
+#include <stdexcept>
+
+#include "AllocationProfiler.h"
+
+namespace tk
+{
+	class Task
+	{
+	public:
+		Task() = default;
+		Task(const Task&) = delete;
+		Task(Task&& donor) noexcept : executor_{std::move(donor.executor_)} {}
+		Task& operator = (const Task&) = delete;
+		Task& operator = (Task&& rhs) noexcept
+		{
+			executor_ = std::move(rhs.executor_);
+			return *this;
+		}
+
+		void operator()()
+		{
+			executor_();
+		}
+
+		operator bool() const
+		{
+			return(bool)executor_;
+		}
+
+		template<typename F, typename ...A>
+		static auto Make(F&& function, A&& ...args)
+		{
+			std::promise<std::invoke_result_t<F, A...>> promise;
+			auto future = promise.get_future();
+			return std::make_pair(
+				Task{ std::forward<F>(function), std::move(promise), std::forward<A>(args)... },
+				std::move(future)
+			);
+		}
+	private:
+		//Fun
+		template<typename F, typename P, typename...A>
+		Task(F&& function, P&& promise, A&&...args)
+		{
+			executor_ = [
+			function = std::forward<F>(function),
+			promise = std::forward<P>(promise),
+			...args = std::forward<A>(args)
+			]() mutable
+			{
+				try {
+					if constexpr (std::is_void_v<std::invoke_result_t<F, A...>>)
+					{
+						function(std::forward<A>(args)...);
+						promise.set_value();
+					}
+					else
+					{
+						promise.set_value(function(std::forward<A>(args)...));
+					}
+				}
+				catch (...)
+				{
+					promise.set_exception(std::current_exception());
+				}
+			};
+		}
+		//Var
+		std::move_only_function<void()> executor_;
+	};
+
+	struct TenantStats
+	{
+		size_t submitted = 0;
+		size_t completed = 0;
+		size_t queued = 0;
+		size_t running = 0;
+		float totalWaitTime = 0.f; //Seconds spent queued, summed over completed tasks
+		float maxWaitTime = 0.f;
+		float totalRunTime = 0.f;
+		float AverageWaitTime() const
+		{
+			return completed ? totalWaitTime / float(completed) : 0.f;
+		}
+	};
+
+	class ThreadPool
+	{
+		struct TenantQueue;
+	public:
+		//Handle to a share of the pool. Tenants are served by deficit round-robin in proportion to
+		//their weight, and never run more than maxConcurrency tasks at once
+		class Tenant
+		{
+		public:
+			Tenant(Tenant&& donor) noexcept : pool_{ std::exchange(donor.pool_, nullptr) }, queue_{ donor.queue_ } {}
+			Tenant(const Tenant&) = delete;
+			Tenant& operator = (const Tenant&) = delete;
+			Tenant& operator = (Tenant&&) = delete;
+
+			template<typename F, typename ...A>
+			auto Run(F&& function, A&& ...args)
+			{
+				return pool_->Submit_(*queue_, std::forward<F>(function), std::forward<A>(args)...);
+			}
+
+			TenantStats GetStats() const
+			{
+				std::lock_guard lk{ pool_->taskQueueMtx_ };
+				return queue_->stats;
+			}
+
+			~Tenant()
+			{
+				if (pool_)
+				{
+					pool_->ReleaseTenant_(*queue_);
+				}
+			}
+
+		private:
+			friend class ThreadPool;
+			Tenant(ThreadPool* pool, TenantQueue* queue) : pool_{ pool }, queue_{ queue } {}
+
+			ThreadPool* pool_;
+			TenantQueue* queue_;
+		};
+
+		//onWorkerStart runs first thing on every worker thread
+		ThreadPool(size_t numWorkers, std::function<void()> onWorkerStart = {})
+			:
+			concurrencyLimit_{ numWorkers },
+			onWorkerStart_{ std::move(onWorkerStart) }
+		{
+			//Tenant 0 takes everything submitted straight to the pool
+			tenants_.push_back(std::make_unique<TenantQueue>());
+			workers.reserve(numWorkers);
+			for (size_t i = 0; i < numWorkers; i++)
+			{
+				workers.emplace_back(this);
+			}
+		}
+
+		template<typename F, typename ...A>
+		auto Run(F&& function, A&& ...args)
+		{
+			return Submit_(*tenants_.front(), std::forward<F>(function), std::forward<A>(args)...);
+		}
+
+		Tenant CreateTenant(float weight = 1.f, size_t maxConcurrency = std::numeric_limits<size_t>::max())
+		{
+			if (weight <= 0.f || maxConcurrency == 0)
+			{
+				throw std::invalid_argument("Tenant needs a positive weight and concurrency");
+			}
+			auto queue = std::make_unique<TenantQueue>();
+			queue->weight = weight;
+			queue->maxConcurrency = maxConcurrency;
+			std::lock_guard lk{ taskQueueMtx_ };
+			tenants_.push_back(std::move(queue));
+			return Tenant{ this, tenants_.back().get() };
+		}
+
+		TenantStats GetStats() const
+		{
+			std::lock_guard lk{ taskQueueMtx_ };
+			return tenants_.front()->stats;
+		}
+
+		//Runs function(0..size-1) on size workers at the same time. Members are only handed out once
+		//enough workers are idle, so gangs whose members wait on each other can never interleave and deadlock
+		template<typename F>
+		std::vector<std::future<void>> RunGang(size_t size, F&& function)
+		{
+			if (size > workers.size())
+			{
+				throw std::runtime_error("Gang is larger than the pool");
+			}
+			if (size == 0)
+			{
+				return {};
+			}
+			alloc::Scope scope{ "pool.gang" };
+			auto shared = std::make_shared<std::decay_t<F>>(std::forward<F>(function));
+			Gang gang;
+			std::vector<std::future<void>> futures;
+			gang.members.reserve(size);
+			futures.reserve(size);
+			for (size_t i = 0; i < size; i++)
+			{
+				auto [task, future] = tk::Task::Make([shared](size_t member) {(*shared)(member); }, i);
+				gang.members.push_back(std::move(task));
+				futures.push_back(std::move(future));
+			}
+			{
+				std::lock_guard lk{ taskQueueMtx_ };
+				gangs_.push_back(std::move(gang));
+			}
+			taskQueueCV_.notify_all();
+			return futures;
+		}
+
+		void WaitForAllDone()
+		{
+			std::unique_lock lk{ taskQueueMtx_ };
+			allDoneCV_.wait(lk, [this] {return queuedTasks_ == 0 && gangs_.empty(); });
+		}
+
+		size_t GetWorkerCount() const
+		{
+			return workers.size();
+		}
+
+		//Caps how many workers run tenant tasks at once (e.g. to a cgroup cpu quota), the rest stay parked.
+		//Gangs are exempt, they are sized by their owner and must always be able to assemble
+		void SetConcurrencyLimit(size_t limit)
+		{
+			{
+				std::lock_guard lk{ taskQueueMtx_ };
+				concurrencyLimit_ = std::max<size_t>(limit, 1);
+			}
+			taskQueueCV_.notify_all();
+		}
+
+		size_t GetConcurrencyLimit() const
+		{
+			std::lock_guard lk{ taskQueueMtx_ };
+			return concurrencyLimit_;
+		}
+
+		~ThreadPool()
+		{
+			for (auto& w : workers)
+			{
+				w.RequestStop();
+			}
+		}
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct QueuedTask
+		{
+			Task task;
+			Clock::time_point enqueued;
+		};
+
+		struct TenantQueue
+		{
+			std::deque<QueuedTask> tasks;
+			float weight = 1.f;
+			size_t maxConcurrency = std::numeric_limits<size_t>::max();
+			float deficit = 0.f;
+			bool released = false;
+			TenantStats stats;
+			bool Eligible() const
+			{
+				return !tasks.empty() && stats.running < maxConcurrency;
+			}
+		};
+
+		//What a worker is currently running
+		struct Assignment
+		{
+			Task task;
+			operator bool() const
+			{
+				return (bool)task;
+			}
+		};
+
+		//Books a tenant task's completion as it leaves the function, before its promise is set, so the stats
+		//are current for anyone who has waited on the future. Runs on unwinding too
+		class Booking
+		{
+		public:
+			Booking(ThreadPool* pool, TenantQueue* tenant) : pool_{ pool }, tenant_{ tenant }, start_{ Clock::now() } {}
+			Booking(const Booking&) = delete;
+			Booking& operator = (const Booking&) = delete;
+			~Booking()
+			{
+				pool_->TaskBooked_(*tenant_, std::chrono::duration<float>(Clock::now() - start_).count());
+			}
+		private:
+			ThreadPool* pool_;
+			TenantQueue* tenant_;
+			Clock::time_point start_;
+		};
+
+		template<typename F, typename ...A>
+		auto Submit_(TenantQueue& tenant, F&& function, A&& ...args)
+		{
+			alloc::Scope scope{ "pool.submit" };
+			auto booked = [this, pTenant = &tenant, function = std::forward<F>(function)](auto&& ...a) mutable -> decltype(auto)
+			{
+				Booking booking{ this, pTenant };
+				return function(std::forward<decltype(a)>(a)...);
+			};
+			auto [task, future] = tk::Task::Make(std::move(booked), std::forward<A>(args)...);
+			{
+				std::lock_guard lk{ taskQueueMtx_ };
+				tenant.tasks.push_back({ std::move(task), Clock::now() });
+				++tenant.stats.submitted;
+				++tenant.stats.queued;
+				++queuedTasks_;
+			}
+			taskQueueCV_.notify_one();
+			return std::move(future);
+		}
+
+		void ReleaseTenant_(TenantQueue& tenant)
+		{
+			std::lock_guard lk{ taskQueueMtx_ };
+			tenant.released = true;
+			EraseReleasedTenants_();
+		}
+
+		void EraseReleasedTenants_()
+		{
+			const auto removed = std::erase_if(tenants_, [](const auto& t) {return t->released && t->tasks.empty() && t->stats.running == 0; });
+			if (removed && rrCursor_ >= tenants_.size())
+			{
+				rrCursor_ = 0;
+			}
+		}
+
+		bool AnyTenantEligible_() const
+		{
+			return activeTasks_ < concurrencyLimit_ && std::ranges::any_of(tenants_, [](const auto& t) {return t->Eligible(); });
+		}
+
+		//Deficit round-robin: arriving at a tenant grants it weight credits, each task costs one
+		TenantQueue& PickTenant_()
+		{
+			while (true)
+			{
+				auto& tenant = *tenants_[rrCursor_];
+				if (tenant.Eligible())
+				{
+					if (rrFresh_)
+					{
+						tenant.deficit += tenant.weight;
+						rrFresh_ = false;
+					}
+					if (tenant.deficit >= 1.f)
+					{
+						tenant.deficit -= 1.f;
+						return tenant;
+					}
+				}
+				else if (tenant.tasks.empty())
+				{
+					tenant.deficit = 0.f; //Idle tenants don't bank credit
+				}
+				rrCursor_ = (rrCursor_ + 1) % tenants_.size();
+				rrFresh_ = true;
+			}
+		}
+
+		Assignment GetTask(std::stop_token& st)
+		{
+			Assignment assignment;
+			std::unique_lock lk{ taskQueueMtx_ };
+			++idleWorkers_;
+			if (GangReady_())
+			{
+				taskQueueCV_.notify_all();
+			}
+			//A pending gang holds back plain tasks so idle workers can accumulate for it
+			taskQueueCV_.wait(lk, st, [this] {return GangReady_() || (gangs_.empty() && AnyTenantEligible_()); });
+			const auto takeFromGang = GangReady_(); //Before leaving the idle count, which readiness depends on
+			--idleWorkers_;
+			if (!st.stop_requested())
+			{
+				++activeTasks_;
+				if (takeFromGang)
+				{
+					auto& gang = gangs_.front();
+					gang.started = true;
+					assignment.task = std::move(gang.members[gang.next++]);
+					if (gang.next == gang.members.size())
+					{
+						gangs_.pop_front();
+					}
+				}
+				else
+				{
+					auto& tenant = PickTenant_();
+					auto& queued = tenant.tasks.front();
+					const auto wait = std::chrono::duration<float>(Clock::now() - queued.enqueued).count();
+					tenant.stats.totalWaitTime += wait;
+					tenant.stats.maxWaitTime = std::max(tenant.stats.maxWaitTime, wait);
+					--tenant.stats.queued;
+					++tenant.stats.running;
+					--queuedTasks_;
+					assignment.task = std::move(queued.task);
+					tenant.tasks.pop_front();
+				}
+				if (queuedTasks_ == 0 && gangs_.empty())
+				{
+					allDoneCV_.notify_all();
+				}
+			}
+			return assignment;
+		}
+
+		void TaskBooked_(TenantQueue& tenant, float runTime)
+		{
+			bool wasCapped = false;
+			{
+				std::lock_guard lk{ taskQueueMtx_ };
+				wasCapped = tenant.stats.running == tenant.maxConcurrency && !tenant.tasks.empty();
+				--tenant.stats.running;
+				++tenant.stats.completed;
+				tenant.stats.totalRunTime += runTime;
+				if (tenant.released)
+				{
+					EraseReleasedTenants_();
+				}
+			}
+			if (wasCapped)
+			{
+				taskQueueCV_.notify_one();
+			}
+		}
+
+		//Any task, tenant or gang, once its promise is set
+		void TaskDone_()
+		{
+			bool wasCapped = false;
+			{
+				std::lock_guard lk{ taskQueueMtx_ };
+				wasCapped = activeTasks_-- >= concurrencyLimit_ && queuedTasks_ > 0;
+			}
+			if (wasCapped)
+			{
+				taskQueueCV_.notify_one();
+			}
+		}
+
+		bool GangReady_() const
+		{
+			if (gangs_.empty())
+			{
+				return false;
+			}
+			const auto& gang = gangs_.front();
+			return gang.started || idleWorkers_ >= gang.members.size() - gang.next;
+		}
+
+		struct Gang
+		{
+			std::vector<Task> members;
+			size_t next = 0;
+			bool started = false;
+		};
+
+		class Worker
+		{
+		public:
+			Worker(ThreadPool* tp) : thread_(std::bind_front(&Worker::RunKernel, this)), pool_{tp} {}
+			void RequestStop()
+			{
+				thread_.request_stop();
+			}
+		private:
+			//Functions
+			void RunKernel(std::stop_token st)
+			{
+				if (pool_->onWorkerStart_)
+				{
+					pool_->onWorkerStart_();
+				}
+				while(auto assignment = pool_->GetTask(st))
+				{
+					{
+						alloc::Scope scope{ "pool.task" };
+						assignment.task();
+					}
+					pool_->TaskDone_();
+				}
+			}
+
+			//Data
+			ThreadPool* pool_;
+			std::jthread thread_;
+		};
+		mutable std::mutex taskQueueMtx_;
+		std::condition_variable_any taskQueueCV_;
+		std::condition_variable_any allDoneCV_;
+		std::vector<std::unique_ptr<TenantQueue>> tenants_;
+		size_t rrCursor_ = 0;
+		bool rrFresh_ = true;
+		size_t queuedTasks_ = 0;
+		size_t activeTasks_ = 0;
+		size_t concurrencyLimit_;
+		std::deque<Gang> gangs_;
+		size_t idleWorkers_ = 0;
+		std::function<void()> onWorkerStart_;
+		std::vector<Worker> workers;
+	};
+}
@@ -1,34 +1,90 @@
 #pragma once
-#include <array>
+#include <vector>
 #include <span>
 #include <format>
 #include <fstream>
 
 #include "Constants.h"
+#include "AllocationProfiler.h"
 
-struct ChunkTimeInfo
+//One chunk's row of a ChunkTimings: per worker time spent working and heavy tasks, and the chunk's time
+template<typename Time, typename Count>
+struct ChunkTimeRow
 {
-	std::array<float, WorkerCount> timeSpentWorkingPerThread;
-	std::array<size_t, WorkerCount> numberOfHeavyPerThread;
-	float totalChunkTime;
+	std::span<Time> timeSpentWorkingPerThread;
+	std::span<Count> numberOfHeavyPerThread;
+	Time& totalChunkTime;
 };
 
-void WriteCSV(const std::span<const ChunkTimeInfo> timings)
+using ChunkTimeInfo = ChunkTimeRow<float, size_t>;
+
+//Timings of a whole experiment, chunks x workers in flat buffers sized once up front, so recording a chunk
+//doesn't allocate. Rows are filled in by chunk index, any order
+class ChunkTimings
 {
+public:
+	ChunkTimings(size_t workerCount = 0, size_t chunkCount = 0)
+		:
+		workerCount{ workerCount },
+		timeSpentWorking(workerCount * chunkCount),
+		numberOfHeavy(workerCount * chunkCount),
+		totalChunkTimes(chunkCount)
+	{}
+
+	ChunkTimeInfo operator[](size_t chunk)
+	{
+		return { std::span{ timeSpentWorking }.subspan(chunk * workerCount, workerCount), std::span{ numberOfHeavy }.subspan(chunk * workerCount, workerCount), totalChunkTimes[chunk] };
+	}
+
+	ChunkTimeRow<const float, const size_t> operator[](size_t chunk) const
+	{
+		return { std::span{ timeSpentWorking }.subspan(chunk * workerCount, workerCount), std::span{ numberOfHeavy }.subspan(chunk * workerCount, workerCount), totalChunkTimes[chunk] };
+	}
+
+	size_t size() const
+	{
+		return totalChunkTimes.size();
+	}
+
+	size_t WorkerCount() const
+	{
+		return workerCount;
+	}
+
+private:
+	size_t workerCount;
+	std::vector<float> timeSpentWorking;
+	std::vector<size_t> numberOfHeavy;
+	std::vector<float> totalChunkTimes;
+};
+
+//One row per chunk when chunks are processed whole by a single worker (pipeline)
+struct StreamChunkTimeInfo
+{
+	size_t chunkIndex;
+	float workTime;
+	size_t numberOfHeavy;
+};
+
+void WriteCSV(const ChunkTimings& timings)
+{
+	alloc::Scope scope{ "csv" };
 	//Output CSV of timings
 // work-time, idle-time, number of heavies x workers + total time, total heavies
 	std::ofstream csv{ "timings.csv", std::ios_base::trunc };
-	for (size_t i = 0; i < WorkerCount; i++)
+	const auto workerCount = timings.WorkerCount();
+	for (size_t i = 0; i < workerCount; i++)
 	{
 		csv << std::format("work_{0:}, idle_{0:}, heavy_{0:}, ", i);
 	}
 	csv << "chunk_time, total_idle, total_heavy\n";
 
-	for (const auto& chunk : timings)
+	for (size_t c = 0; c < timings.size(); c++)
 	{
+		const auto chunk = timings[c];
 		float totalIdle = 0.f;
 		size_t totalHeavy = 0;
-		for (size_t i = 0; i < WorkerCount; i++)
+		for (size_t i = 0; i < workerCount; i++)
 		{
 			const auto idle = chunk.totalChunkTime - chunk.timeSpentWorkingPerThread[i];
 			const auto heavy = chunk.numberOfHeavyPerThread[i];
@@ -38,4 +94,15 @@ void WriteCSV(const std::span<const ChunkTimeInfo> timings)
 		}
 		csv << std::format("{},{},{}\n", chunk.totalChunkTime, totalIdle, totalHeavy);
 	}
+}
+
+void WriteCSV(const std::span<const StreamChunkTimeInfo> timings)
+{
+	alloc::Scope scope{ "csv" };
+	std::ofstream csv{ "timings.csv", std::ios_base::trunc };
+	csv << "chunk, work_time, heavy\n";
+	for (const auto& chunk : timings)
+	{
+		csv << std::format("{},{},{}\n", chunk.chunkIndex, chunk.workTime, chunk.numberOfHeavy);
+	}
 }
\ No newline at end of file
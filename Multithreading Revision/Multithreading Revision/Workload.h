@@ -0,0 +1,269 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+#include "Constants.h"
+#include "Task.h"
+#include "ChunkView.h"
+#include "MathPolicy.h"
+#include "Kernel.h"
+
+//What the engines (pre, que, atq) run: an item type, what processing one item yields and how results combine.
+//A workload can also provide bulk hooks (ProcessChunk, HeavyCount, Batch, Prepare, Verify), the engines
+//pick those up at compile time through the work:: helpers and fall back to per-item calls otherwise.
+//The engines call everything through the experiment's workload instance, so static hooks and hooks reading
+//per-experiment settings off the instance both work
+template<typename W>
+concept Workload = requires(const W& w, const typename W::Item& item, typename W::Result a, typename W::Result b)
+{
+	{ w.Process(item) } -> std::same_as<typename W::Result>;
+	{ w.Cost(item) } -> std::convertible_to<size_t>; //Relative cost hint, 1 is a light item
+	{ w.Reduce(a, b) } -> std::same_as<typename W::Result>;
+	{ w.Identity() } -> std::same_as<typename W::Result>;
+};
+
+//The Task workload under a math policy, every hook goes straight to the tuned kernels. errorBound is the relative
+//error on the result Verify allows an inexact policy
+template<math::Policy Math = math::Default>
+struct TaskWorkload
+{
+	using Item = Task;
+	using Result = unsigned int;
+	using Batch = kernel::Batch<Math>;
+
+	explicit TaskWorkload(double errorBound = MathErrorBound) : errorBound{ errorBound } {}
+
+	static Result Process(const Task& task)
+	{
+		return kernel::Process<Math>(task);
+	}
+	static size_t Cost(const Task& task)
+	{
+		return task.heavy ? HeavyIterations / LightIterations : 1;
+	}
+	static Result Reduce(Result a, Result b)
+	{
+		return a + b;
+	}
+	static Result Identity()
+	{
+		return 0;
+	}
+
+	template<ChunkViewType View>
+	static Result ProcessChunk(const View& tasks)
+	{
+		return kernel::Process<Math>(tasks);
+	}
+	template<ChunkViewType View>
+	static size_t HeavyCount(const View& tasks)
+	{
+		return tasks.HeavyCount();
+	}
+	static void Prepare()
+	{
+		kernel::Prepare<Math>();
+	}
+	template<typename Data>
+	bool Verify(const Data& chunks, Result result, std::ostream& out) const
+	{
+		return kernel::Verify<Math>(chunks, result, out, errorBound);
+	}
+
+	double errorBound;
+};
+
+//The Task workload (libm) with trip counts set at runtime, for configurations Constants.h wasn't compiled for.
+//Trip counts in CompiledTripCounts still get a fixed-count kernel, picked once on construction, anything else
+//runs a loop bounded at runtime
+struct RuntimeTaskWorkload
+{
+	using Item = Task;
+	using Result = unsigned int;
+
+	struct TripCount
+	{
+		size_t iterations;
+		Result(*kernel)(const Task&); //Null when no kernel was compiled for this count
+	};
+
+	static constexpr std::array<size_t, 4> CompiledTripCounts{ LightIterations, HeavyIterations, 10, 10'000 };
+
+	explicit RuntimeTaskWorkload(size_t lightIterations = LightIterations, size_t heavyIterations = HeavyIterations)
+		:
+		light{ Select_(lightIterations) },
+		heavy{ Select_(heavyIterations) }
+	{}
+
+	Result Process(const Task& task) const
+	{
+		const auto& trip = task.heavy ? heavy : light;
+		return trip.kernel ? trip.kernel(task) : task.Process(trip.iterations);
+	}
+	size_t Cost(const Task& task) const
+	{
+		return task.heavy ? std::max<size_t>(heavy.iterations / light.iterations, 2) : 1;
+	}
+	static Result Reduce(Result a, Result b)
+	{
+		return a + b;
+	}
+	static Result Identity()
+	{
+		return 0;
+	}
+
+private:
+	template<size_t Iterations>
+	static Result Fixed_(const Task& task)
+	{
+		return task.Process<Iterations>();
+	}
+
+	static TripCount Select_(size_t iterations)
+	{
+		TripCount trip{ iterations, nullptr };
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			((iterations == CompiledTripCounts[I] ? (trip.kernel = &Fixed_<CompiledTripCounts[I]>, true) : false) || ...);
+		}(std::make_index_sequence<CompiledTripCounts.size()>{});
+		return trip;
+	}
+
+	TripCount light;
+	TripCount heavy;
+};
+
+namespace work
+{
+	template<Workload W>
+	bool IsHeavy(const W& w, const typename W::Item& item)
+	{
+		return w.Cost(item) > 1;
+	}
+
+	template<Workload W, typename View>
+	typename W::Result ProcessChunk(const W& w, const View& items)
+	{
+		if constexpr (requires { w.ProcessChunk(items); })
+		{
+			return w.ProcessChunk(items);
+		}
+		else
+		{
+			auto result = w.Identity();
+			for (size_t i = 0; i < items.size(); i++)
+			{
+				result = w.Reduce(result, w.Process(items[i]));
+			}
+			return result;
+		}
+	}
+
+	template<Workload W, typename View>
+	size_t HeavyCount(const W& w, const View& items)
+	{
+		if constexpr (requires { w.HeavyCount(items); })
+		{
+			return w.HeavyCount(items);
+		}
+		else
+		{
+			size_t count = 0;
+			for (size_t i = 0; i < items.size(); i++)
+			{
+				count += IsHeavy(w, items[i]);
+			}
+			return count;
+		}
+	}
+
+	namespace detail
+	{
+		template<Workload W>
+		class Unbatched
+		{
+		public:
+			explicit Unbatched(const W& w) : w{ w } {}
+
+			typename W::Result Push(const typename W::Item& item)
+			{
+				return w.Process(item);
+			}
+			typename W::Result Flush()
+			{
+				return w.Identity();
+			}
+
+		private:
+			const W& w;
+		};
+
+		template<Workload W>
+		struct BatchOf
+		{
+			using type = Unbatched<W>;
+		};
+
+		template<Workload W> requires requires { typename W::Batch; }
+		struct BatchOf<W>
+		{
+			using type = typename W::Batch;
+		};
+	}
+
+	//Collects items handed out one at a time: Push/Flush return the result of whatever got processed
+	template<Workload W>
+	using Batch = typename detail::BatchOf<W>::type;
+
+	//A Batch for w, built from it unless the workload's own Batch stands alone
+	template<Workload W>
+	Batch<W> MakeBatch(const W& w)
+	{
+		if constexpr (std::is_constructible_v<Batch<W>, const W&>)
+		{
+			return Batch<W>{ w };
+		}
+		else
+		{
+			return Batch<W>{};
+		}
+	}
+
+	//Call before a crew occupies the runtime
+	template<Workload W>
+	void Prepare(const W& w)
+	{
+		if constexpr (requires { w.Prepare(); })
+		{
+			w.Prepare();
+		}
+	}
+
+	template<Workload W, typename Data>
+	bool Verify(const W& w, const Data& chunks, const typename W::Result& result, std::ostream& out)
+	{
+		if constexpr (requires { w.Verify(chunks, result, out); })
+		{
+			return w.Verify(chunks, result, out);
+		}
+		else
+		{
+			return true;
+		}
+	}
+
+	template<Workload W>
+	void Report(std::ostream& out, const typename W::Result& result)
+	{
+		if constexpr (requires { out << result; })
+		{
+			out << "Result is " << result << std::endl;
+		}
+	}
+}
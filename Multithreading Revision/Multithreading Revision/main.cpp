@@ -19,165 +19,19 @@
 #include "Timing.h"
 #include "Queued.h"
 #include "AtomicQueue.h"
+#include "ThreadPool.h"
+#include "Runtime.h"
+#include "Pipelined.h"
+#include "SimdKernel.h"
+#include "JumpTable.h"
+#include "AllocationHooks.h"
 #include "popl.h"
+#include "Config.h"
 
-namespace tk
-{
-	class Task
-	{
-	public:
-		Task() = default;
-		Task(const Task&) = delete;
-		Task(Task&& donor) noexcept : executor_{std::move(donor.executor_)} {}
-		Task& operator = (const Task&) = delete;
-		Task& operator = (Task&& rhs) noexcept
-		{
-			executor_ = std::move(rhs.executor_);
-			return *this;
-		}
-
-		void operator()()
-		{
-			executor_();
-		}
-
-		operator bool() const
-		{
-			return(bool)executor_;
-		}
-
-		template<typename F, typename ...A>
-		static auto Make(F&& function, A&& ...args)
-		{
-			std::promise<std::invoke_result_t<F, A...>> promise;
-			auto future = promise.get_future();
-			return std::make_pair(
-				Task{ std::forward<F>(function), std::move(promise), std::forward<A>(args)... },
-				std::move(future)
-			);
-		}
-	private:
-		//Fun
-		template<typename F, typename P, typename...A>
-		Task(F&& function, P&& promise, A&&...args)
-		{
-			executor_ = [
-			function = std::forward<F>(function),
-			promise = std::forward<P>(promise),
-			...args = std::forward<A>(args)
-			]() mutable
-			{
-				try {
-					if constexpr (std::is_void_v<std::invoke_result_t<F, A...>>)
-					{
-						function(std::forward<A>(args)...);
-						promise.set_value();
-					}
-					else
-					{
-						promise.set_value(function(std::forward<A>(args)...));
-					}
-				}
-				catch (...)
-				{
-					promise.set_exception(std::current_exception());
-				}
-			};
-		}
-		//Var
-		std::move_only_function<void()> executor_;
-	};
-
-	class ThreadPool
-	{
-	public:
-		ThreadPool(size_t numWorkers)
-		{
-			workers.reserve(numWorkers);
-			for (size_t i = 0; i < numWorkers; i++)
-			{
-				workers.emplace_back(this);
-			}
-		}
-
-		template<typename F, typename ...A>
-		auto Run(F&& function, A&& ...args)
-		{
-			auto [task, future] = tk::Task::Make(std::forward<F>(function), std::forward<A>(args)...);
-			{
-				std::lock_guard lk{ taskQueueMtx_ };
-				tasks_.push_back(std::move(task));
-			}
-			taskQueueCV_.notify_one();
-			return std::move(future);
-		}
-
-		void WaitForAllDone()
-		{
-			std::unique_lock lk{ taskQueueMtx_ };
-			allDoneCV_.wait(lk, [this] {return tasks_.empty(); });
-		}
-
-		~ThreadPool()
-		{
-			for (auto& w : workers)
-			{
-				w.RequestStop();
-			}
-		}
-
-	private:
-		Task GetTask(std::stop_token& st)
-		{
-			Task task;
-			std::unique_lock lk{ taskQueueMtx_ };
-			taskQueueCV_.wait(lk, st, [this] {return !tasks_.empty(); });
-			if (!st.stop_requested())
-			{
-				task = std::move(tasks_.front());
-				tasks_.pop_front();
-				if (tasks_.empty())
-				{
-					allDoneCV_.notify_all();
-				}
-			}
-			return task;
-		}
-
-		class Worker
-		{
-		public:
-			Worker(ThreadPool* tp) : thread_(std::bind_front(&Worker::RunKernel, this)), pool_{tp} {}
-			void RequestStop()
-			{
-				thread_.request_stop();
-			}
-		private:
-			//Functions
-			void RunKernel(std::stop_token st)
-			{
-				while(auto task = pool_->GetTask(st))
-				{
-					task();
-				}
-			}
-
-			//Data
-			ThreadPool* pool_;
-			std::jthread thread_;
-		};
-		std::mutex taskQueueMtx_;
-		std::condition_variable_any taskQueueCV_;
-		std::condition_variable_any allDoneCV_;
-		std::deque<Task> tasks_;
-		std::vector<Worker> workers;
-	};
-}
-
-int main(int argc, char** argv)
+//Thread pool features on sleeping tasks, and the kernels enabled in Constants.h against the reference
+void RunDemos(tk::ThreadPool& pool)
 {
 	using namespace std::chrono_literals;
-	tk::ThreadPool pool{ 4 };
 
 	//Exceptions
 	{
@@ -219,5 +73,84 @@ int main(int argc, char** argv)
 		std::cout << "Task Ready! Value is: " << future.get() << std::endl;
 	}
 
-	return 0;
+	//Fair sharing
+	{
+		auto bulk = pool.CreateTenant();
+		auto interactive = pool.CreateTenant(1.f, 1);
+		const auto work = [] {std::this_thread::sleep_for(1ms); };
+
+		std::vector<std::future<void>> futures;
+		for (int i = 0; i < 2'000; i++)
+		{
+			futures.push_back(bulk.Run(work));
+		}
+		for (int i = 0; i < 20; i++)
+		{
+			futures.push_back(interactive.Run(work));
+		}
+		for (auto& f : futures)
+		{
+			f.get();
+		}
+
+		for (const auto& [name, stats] : { std::pair{ "bulk", bulk.GetStats() }, std::pair{ "interactive", interactive.GetStats() } })
+		{
+			std::cout << std::format("{}: {} tasks, avg wait {}s, max wait {}s, run {}s\n",
+				name, stats.completed, stats.AverageWaitTime(), stats.maxWaitTime, stats.totalRunTime);
+		}
+	}
+
+	//Kernel validations
+	if constexpr (jumpTableEnabled)
+	{
+		jump::Validate(std::cout);
+	}
+	if constexpr (simdKernelEnabled)
+	{
+		simd::Validate(std::cout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	cfg::Options options;
+	cfg::Params params;
+	try {
+		params = options.Parse(argc, argv);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n" << options.Help();
+		return 1;
+	}
+	if (params.help)
+	{
+		std::cout << options.Help();
+		return 0;
+	}
+	tk::SetWorkerCountOverride(params.workers); //Before the runtime sizes its pool
+
+	if (params.demos)
+	{
+		RunDemos(tk::Runtime());
+		return 0;
+	}
+
+	//Experiment chosen on the command line
+	int experimentResult = 0;
+	try {
+		experimentResult = cfg::Run(params);
+	}
+	catch (const std::exception& e) //A dataset file that can't be opened or read, say
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	if constexpr (allocationProfilingEnabled)
+	{
+		alloc::Report(std::cout);
+	}
+
+	return experimentResult;
 }
\ No newline at end of file